@@ -0,0 +1,166 @@
+#include "slab_allocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <forward_list>
+#include <list>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// ==============================================================
+// = Benchmark Iterate: incrementing every element of a list,   =
+// = forward_list, map and hand linked list, with and without   =
+// = prefetching the nodes ahead (see slab_prefetch.h), for     =
+// = sizes that double from 1 to max_elements                   =
+// ==============================================================
+
+size_t const max_elements = 1 << 20;
+int const num_runs = 5;
+
+// Elements traversed in each run, so that small containers are timed over
+// several traversals
+size_t const min_elements_per_run = 1 << 16;
+
+static void escape(void *p) {
+  asm volatile("" : : "g"(p) : "memory");
+}
+
+// Best time of [num_runs] runs of [f] over [n] elements, in nanoseconds per
+// element
+template <typename F>
+double time_per_element(size_t n, F f) {
+  size_t reps = std::max<size_t>(1, min_elements_per_run / n);
+  double best = 0;
+  for (int run = 0; run < num_runs; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) {
+      f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    if (run == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best / (n * reps);
+}
+
+// Time a plain traversal of [c] and a prefetching one
+template <typename C, typename Inc>
+void time_iterate(C& c, size_t n, Inc inc, double& plain, double& pref) {
+  escape(&c);
+  plain = time_per_element(n, [&]() {
+    for (auto it = c.begin(); it != c.end(); ++it) {
+      inc(*it);
+    }
+    escape(&c);
+  });
+  pref = time_per_element(n, [&]() {
+    for (auto& x : prefetched(c)) {
+      inc(x);
+    }
+    escape(&c);
+  });
+}
+
+// A node of a hand linked list, whose nodes link to the next one with
+// pointers of type [P]
+template <typename P>
+struct Node {
+  long long value;
+  typename std::pointer_traits<P>::template rebind<Node> next;
+};
+
+// Run the benchmarks for each size with allocators of type [Alloc]. The
+// elements are inserted in a random order and the list and forward_list are
+// then sorted, so that consecutive nodes are not next to each other in the
+// slab, like in a container that has seen many insertions and erasures.
+template <typename Alloc>
+void bench(const char *name) {
+  using map_alloc = typename std::allocator_traits<Alloc>::template
+    rebind_alloc<std::pair<const long long, long long>>;
+  auto inc = [](long long& x) { ++x; };
+  auto inc_value = [](std::pair<const long long, long long>& kv) { ++kv.second; };
+
+  printf("%s\n", name);
+  using node = Node<typename std::allocator_traits<Alloc>::pointer>;
+  using node_alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<node>;
+  using node_pointer = typename std::allocator_traits<node_alloc>::pointer;
+
+  printf("%10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "elements", "list",
+         "prefetch", "fwd_list", "prefetch", "map", "prefetch", "nodes", "prefetch");
+
+  std::mt19937 rng(0);
+  for (size_t n = 1; n <= max_elements; n *= 2) {
+    std::vector<long long> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    double times[8];
+    {
+      std::list<long long, Alloc> lst;
+      lst.assign(keys.begin(), keys.end());
+      lst.sort();
+      time_iterate(lst, n, inc, times[0], times[1]);
+    }
+    {
+      std::forward_list<long long, Alloc> flst;
+      flst.assign(keys.begin(), keys.end());
+      flst.sort();
+      time_iterate(flst, n, inc, times[2], times[3]);
+    }
+    {
+      std::map<long long, long long, std::less<long long>, map_alloc> m;
+      for (long long k : keys) {
+        m.emplace(k, 42);
+      }
+      time_iterate(m, n, inc_value, times[4], times[5]);
+    }
+    {
+      // Allocate the nodes in order and link them in the order of [keys]
+      node_alloc alloc;
+      std::vector<node_pointer> nodes(n);
+      for (size_t i = 0; i < n; ++i) {
+        nodes[i] = alloc.allocate(1);
+      }
+      node_pointer head = nullptr;
+      for (long long k : keys) {
+        nodes[k]->value = k;
+        nodes[k]->next = head;
+        head = nodes[k];
+      }
+
+      times[6] = time_per_element(n, [&]() {
+        for (node_pointer p = head; p != nullptr; p = p->next) {
+          ++p->value;
+        }
+        escape(&*head);
+      });
+      times[7] = time_per_element(n, [&]() {
+        for_each_node(head, &node::next, [](node& x) { ++x.value; });
+        escape(&*head);
+      });
+
+      for (size_t i = 0; i < n; ++i) {
+        alloc.deallocate(nodes[i], 1);
+      }
+    }
+
+    printf("%10zu", n);
+    for (double ns : times) {
+      printf(" %10.2f", ns);
+    }
+    printf("\n");
+  }
+}
+
+int main(void)
+{
+  printf("ns per element, best of %d runs\n", num_runs);
+  bench<std::allocator<long long>>("raw pointer");
+  bench<SlabAllocator<long long>>("fancy_pointer");
+}
@@ -0,0 +1,75 @@
+#include "slab_allocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// ==============================================================
+// = Benchmark pointer_to: turning an address into a fancy      =
+// = pointer through the slab index, against scanning every     =
+// = slab in the slab lookup table                              =
+// ==============================================================
+
+size_t const num_objects = 1 << 16;
+int const num_runs = 5;
+
+// Best time of [num_runs] runs of [f] over [n] calls, in nanoseconds per
+// call
+template <typename F>
+double time_per_call(size_t n, F f) {
+  double best = 0;
+  for (int run = 0; run < num_runs; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    if (run == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best / n;
+}
+
+// Offsets of the results, which the compiler can't optimize away
+volatile long sink;
+
+template <typename F>
+void report(const char *what, F pointer_to, const std::vector<char*>& addrs) {
+  double ns = time_per_call(addrs.size(), [&]() {
+    long sum = 0;
+    for (char *addr : addrs) {
+      sum += pointer_to(*addr).offset;
+    }
+    sink = sum;
+  });
+  printf("%-36s %12.2f\n", what, ns);
+}
+
+int main(void)
+{
+  // Objects in slabs of every size from 8 bytes to 64 KiB, in random order
+  SlabAllocator<char> alloc;
+  std::vector<char*> in_slabs;
+  for (size_t i = 0; i < num_objects; ++i) {
+    in_slabs.push_back(&*alloc.allocate(size_t(8) << (i % 14)));
+  }
+  std::shuffle(in_slabs.begin(), in_slabs.end(), std::mt19937(0));
+
+  // Objects outside of slabs, like the sentinel node of a container whose
+  // header is on the stack, have to be compared against every slab of every
+  // machine before falling back to a raw fancy pointer
+  char local[64];
+  std::vector<char*> outside(num_objects, local);
+
+  auto indexed = [](char& r) { return fancy_pointer<char>::pointer_to(r); };
+  auto scanned = [](char& r) { return fancy_pointer<char>::scan_pointer_to(r); };
+
+  printf("%zu calls, best of %d runs\n", num_objects, num_runs);
+  printf("%-36s %12s\n", "pointer_to", "ns per call");
+  report("slab object, index", indexed, in_slabs);
+  report("slab object, scan", scanned, in_slabs);
+  report("object outside of slabs, index", indexed, outside);
+  report("object outside of slabs, scan", scanned, outside);
+}
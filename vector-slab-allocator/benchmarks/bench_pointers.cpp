@@ -0,0 +1,178 @@
+#include "slab_allocator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+// ==============================================================
+// = Benchmark Pointers: node density and traversal speed of    =
+// = the containers in tests/test_containers.cpp, for each      =
+// = pointer type that a SlabAllocator can hand out             =
+// ==============================================================
+
+size_t const num_elements = 1 << 20;
+int const num_runs = 5;
+
+// A vector is a single object, which has to fit in a slab segment region
+// for compressed pointers (see compressed_pointer.h)
+size_t const num_vector_elements = 1 << 18;
+
+// Best time of [num_runs] runs of [f] over [n] elements, in nanoseconds per
+// element
+template <typename F>
+double time_per_element(size_t n, F f) {
+  double best = 0;
+  for (int run = 0; run < num_runs; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    if (run == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best / n;
+}
+
+// Size of the slots that hold the nodes of a container, i.e. of the slab
+// with the most blocks, or 0 if it is unknown
+template <typename T>
+size_t node_slot_sz(const std::allocator<T>&) {
+  return 0;
+}
+
+template <typename T, template <typename> class Ptr>
+size_t node_slot_sz(const SlabAllocator<T, Ptr>& alloc) {
+  Slab *nodes = nullptr;
+  for (Slab *slab : alloc.internal->slabs) {
+    if (slab != nullptr &&
+        (nodes == nullptr || slab->slab_md()->num_blocks > nodes->slab_md()->num_blocks)) {
+      nodes = slab;
+    }
+  }
+  return (nodes == nullptr) ? 0 : nodes->slab_md()->sz;
+}
+
+void report(const char *name, const char *container, size_t slot_sz, double ns) {
+  if (slot_sz == 0) {
+    printf("%-24s %-8s %10s %14s %12.2f\n", name, container, "-", "-", ns);
+  } else {
+    printf("%-24s %-8s %10zu %14.1f %12.2f\n", name, container, slot_sz,
+           64.0 / slot_sz, ns);
+  }
+}
+
+// Sum of the elements of [c], which the compiler can't optimize away
+volatile long sink;
+
+// Construct a [C] in memory from [alloc], like the containers of
+// tests/test_containers.cpp, so that sentinel nodes in its header are in a
+// slab too (compressed pointers can't point anywhere else)
+template <typename C, typename Alloc>
+C* make_container(const Alloc& alloc) {
+  typename std::allocator_traits<Alloc>::template rebind_alloc<C> c_alloc(alloc);
+  return new (&*c_alloc.allocate(1)) C(alloc);
+}
+
+template <typename C, typename Alloc>
+void destroy_container(const Alloc& alloc, C* c) {
+  using c_alloc_type = typename std::allocator_traits<Alloc>::template rebind_alloc<C>;
+  using c_pointer = typename std::allocator_traits<c_alloc_type>::pointer;
+  c_alloc_type c_alloc(alloc);
+  c->~C();
+  c_alloc.deallocate(std::pointer_traits<c_pointer>::pointer_to(*c), 1);
+}
+
+// Fancy pointers that only store their slab id (see pinned_fancy_pointer.h)
+template <typename T>
+using local_fancy_pointer = pinned_fancy_pointer<T, LOCAL_M_ID>;
+
+// Run the benchmarks with allocators returned by [make_alloc]
+template <typename Alloc, typename Make>
+void bench(const char *name, Make make_alloc) {
+  using traits = std::allocator_traits<Alloc>;
+
+  {
+    Alloc alloc = make_alloc();
+    auto lst = make_container<std::list<int, Alloc>>(alloc);
+    for (size_t i = 0; i < num_elements; ++i) {
+      lst->push_back(i);
+    }
+    double ns = time_per_element(num_elements, [&]() {
+      long sum = 0;
+      for (int x : *lst) {
+        sum += x;
+      }
+      sink = sum;
+    });
+    report(name, "list", node_slot_sz(alloc), ns);
+    destroy_container(alloc, lst);
+  }
+
+  {
+    using map_alloc = typename traits::template rebind_alloc<std::pair<const int, int>>;
+    map_alloc alloc(make_alloc());
+    auto m = make_container<std::map<int, int, std::less<int>, map_alloc>>(alloc);
+    for (size_t i = 0; i < num_elements; ++i) {
+      m->emplace(i, i);
+    }
+    double ns = time_per_element(num_elements, [&]() {
+      long sum = 0;
+      for (auto& kv : *m) {
+        sum += kv.second;
+      }
+      sink = sum;
+    });
+    report(name, "map", node_slot_sz(alloc), ns);
+    destroy_container(alloc, m);
+  }
+
+  {
+    Alloc alloc = make_alloc();
+    auto vec = make_container<std::vector<int, Alloc>>(alloc);
+    vec->reserve(num_vector_elements);
+    for (size_t i = 0; i < num_vector_elements; ++i) {
+      vec->push_back(i);
+    }
+    double ns = time_per_element(num_vector_elements, [&]() {
+      long sum = 0;
+      for (int x : *vec) {
+        sum += x;
+      }
+      sink = sum;
+    });
+    report(name, "vector", 0, ns);
+    destroy_container(alloc, vec);
+  }
+}
+
+template <typename Alloc>
+void bench(const char *name) {
+  bench<Alloc>(name, []() { return Alloc(); });
+}
+
+int main(void)
+{
+  printf("%zu list and map elements, %zu vector elements, best of %d traversals\n",
+         num_elements, num_vector_elements, num_runs);
+  printf("%-24s %-8s %10s %14s %12s\n", "pointer", "container", "node slot",
+         "nodes per line", "ns per elem");
+
+  bench<std::allocator<int>>("raw pointer");
+  bench<SlabAllocator<int>>("fancy_pointer");
+  bench<SlabAllocator<int, packed_fancy_pointer>>("packed_fancy_pointer");
+  bench<SlabAllocator<int, default_compressed_pointer>>("compressed_pointer", []() {
+    return make_compressed_allocator<int, default_compressed_pointer>(1);
+  });
+  // Links to the sentinel node in the container header cross slabs, so the
+  // slabs must not move
+  bench<SlabAllocator<int, relative_pointer>>("relative_pointer", []() {
+    return SlabAllocator<int, relative_pointer>(shared_segment,
+                                                memfd_create("bench", MFD_CLOEXEC), 2);
+  });
+  bench<SlabAllocator<int, local_fancy_pointer>>("local_fancy_pointer");
+  bench<SlabAllocator<int, cached_fancy_pointer>>("cached_fancy_pointer");
+}
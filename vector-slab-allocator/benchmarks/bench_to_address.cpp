@@ -0,0 +1,59 @@
+#include "slab_allocator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// ==============================================================
+// = Benchmark to_address: resolving fancy pointers collected   =
+// = from a container one at a time, against to_addresses       =
+// ==============================================================
+
+size_t const num_pointers = 1 << 16;
+int const num_runs = 20;
+
+// Best time of [num_runs] runs of [f], in nanoseconds per pointer
+template <typename F>
+double time_per_pointer(F f) {
+  double best = 0;
+  for (int run = 0; run < num_runs; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    if (run == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best / num_pointers;
+}
+
+// Sum of the addresses, which the compiler can't optimize away
+volatile uintptr_t sink;
+
+int main(void)
+{
+  SlabAllocator<long> alloc;
+  std::vector<fancy_pointer<long>> ptrs;
+  for (size_t i = 0; i < num_pointers; ++i) {
+    ptrs.push_back(alloc.allocate(1));
+  }
+  std::vector<long*> addrs(num_pointers);
+
+  double one_by_one = time_per_pointer([&]() {
+    for (size_t i = 0; i < num_pointers; ++i) {
+      addrs[i] = fancy_pointer<long>::to_address(ptrs[i]);
+    }
+    sink = uintptr_t(addrs[num_pointers / 2]);
+  });
+
+  double bulk = time_per_pointer([&]() {
+    to_addresses(ptrs.data(), num_pointers, addrs.data());
+    sink = uintptr_t(addrs[num_pointers / 2]);
+  });
+
+  printf("%zu pointers into one slab, best of %d runs\n", num_pointers, num_runs);
+  printf("%-24s %14s\n", "translation", "ns per pointer");
+  printf("%-24s %14.2f\n", "to_address", one_by_one);
+  printf("%-24s %14.2f\n", "to_addresses", bulk);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include "fancy_pointer.h"
+#include "fancy_pointer_base.h"
+#include "slab_cache.h"
+
+// A fancy pointer that is followed through the per-thread slab cache (see
+// slab_cache.h) instead of the slab lookup table. It is laid out like a
+// fancy_pointer, with the same null and raw forms, so slabs that hold these
+// can be exported, swizzled and validated like any other, and it converts
+// to and from fancy_pointer.
+template <typename T>
+struct cached_fancy_pointer
+  : fancy_pointer_base<cached_fancy_pointer<T>, T>
+{
+  using base = fancy_pointer_base<cached_fancy_pointer<T>, T>;
+  using typename base::difference_type;
+
+  int m_id;
+  int s_id;
+  difference_type offset;
+
+  cached_fancy_pointer() : m_id(-1), s_id(-1), offset(0) {}
+
+  cached_fancy_pointer(std::nullptr_t) : m_id(-1), s_id(-1), offset(0) {}
+
+  cached_fancy_pointer(int m, int s, difference_type o) : m_id(m), s_id(s), offset(o) {}
+
+  template<typename U, typename ignore = std::enable_if_t<!std::is_const_v<U> || std::is_const_v<T>>* >
+  cached_fancy_pointer(const cached_fancy_pointer<U> &p)
+    : m_id(p.m_id), s_id(p.s_id), offset(p.offset) {}
+
+  template<typename U, typename ignore = std::enable_if_t<!std::is_const_v<U> || std::is_const_v<T>>* >
+  cached_fancy_pointer(const fancy_pointer<U> &p)
+    : m_id(p.m_id), s_id(p.s_id), offset(p.offset) {}
+
+  operator fancy_pointer<T>() const { return fancy_pointer<T>(m_id, s_id, offset); }
+
+  // Null (s_id -1) and raw (s_id 0) pointers hold an address, and so does a
+  // pointer into a slab that is not registered, like for fancy_pointer
+  T *get() const {
+    if (s_id <= 0) {
+      return (T*) offset;
+    }
+    return (T*) (uintptr_t(cached_slab_blocks(m_id, s_id)) + offset);
+  }
+
+  bool equals(const cached_fancy_pointer& rhs) const {
+    return m_id == rhs.m_id && s_id == rhs.s_id && offset == rhs.offset;
+  }
+
+  void advance(difference_type bytes) { offset += bytes; }
+
+  template<bool V = !std::is_void_v<T>>
+  static cached_fancy_pointer pointer_to(std::enable_if_t<V, T> &r) {
+    return fancy_pointer<T>::pointer_to(r);
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const cached_fancy_pointer &p) {
+    return os << "{m_id = " << p.m_id
+              << "; s_id = " << p.s_id
+              << "; offset = " << p.offset << "}";
+  }
+};
+
+static_assert(sizeof(cached_fancy_pointer<int>) == sizeof(fancy_pointer<int>),
+              "Cached fancy pointers should be laid out like fancy pointers");
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "fancy_pointer_base.h"
+#include "slab_segment.h"
+
+// The region that compressed pointers with the tag [Tag] point into: a
+// SlabSegment, whose slabs sit at fixed offsets and never move, so every
+// object in it is a 32 bit offset from the start of the segment
+template <typename Tag>
+struct compressed_region {
+  // Start of the segment in this process, or null if there is none
+  static inline char *base = nullptr;
+
+  // Make [segment] the region of [Tag], which must not have one already:
+  // the pointers into the old region would silently point into the new one
+  static void attach(SlabSegment& segment) {
+    if (segment.len > (1ULL << 32)) {
+      throw std::runtime_error("Slab segment is too large for compressed pointers");
+    }
+    if (base != nullptr) {
+      throw std::runtime_error("Compressed pointer tag is already attached to a slab segment");
+    }
+    base = segment.base;
+  }
+
+  // Stop using [segment] as the region of [Tag], before it is unmapped
+  static void detach(SlabSegment& segment) {
+    if (base == segment.base) {
+      base = nullptr;
+    }
+  }
+};
+
+struct default_compressed_tag {};
+
+// A 4 byte pointer to an object in the compressed_region of [Tag], stored as
+// its offset from the start of the region, like a compressed oop. Links in
+// node based containers are then half the size of raw pointers, and the
+// offsets stay valid in every process that maps the same segment, or that
+// loads an image of it into its own segment (see SlabSegment::load).
+// To give an allocator its own region, use a tag of its own:
+//   struct shard_tag {};
+//   template <typename T> using shard_pointer = compressed_pointer<T, shard_tag>;
+//   auto alloc = make_compressed_allocator<T, shard_pointer>(m_id);
+// Note: every object that is pointed to has to be in the region, including
+// the headers of containers, which hold the sentinel nodes of some of them
+// Note: blocks have 64 slots and must fit in a region of the segment, so
+// with the default region size objects are at most 1 MiB
+template <typename T, typename Tag = default_compressed_tag>
+struct compressed_pointer
+  : fancy_pointer_base<compressed_pointer<T, Tag>, T>
+{
+  using base = fancy_pointer_base<compressed_pointer<T, Tag>, T>;
+  using typename base::difference_type;
+  using tag = Tag;
+
+  // Offset from the start of the region, where 0 (the header of the
+  // segment, which is never allocated from) is null
+  uint32_t off;
+
+  compressed_pointer() : off(0) {}
+
+  compressed_pointer(std::nullptr_t) : off(0) {}
+
+  template<typename U, typename ignore = std::enable_if_t<!std::is_const_v<U> || std::is_const_v<T>>* >
+  compressed_pointer(const compressed_pointer<U, Tag> &p) : off(p.off) {}
+
+  T *get() const {
+    return (off == 0) ? nullptr : (T*) (compressed_region<Tag>::base + off);
+  }
+
+  bool equals(const compressed_pointer& rhs) const { return off == rhs.off; }
+
+  void advance(difference_type bytes) { off += bytes; }
+
+  template<bool V = !std::is_void_v<T>>
+  static compressed_pointer pointer_to(std::enable_if_t<V, T> &r) {
+    char *addr = reinterpret_cast<char*>(std::addressof(r));
+    char *start = compressed_region<Tag>::base;
+    if (start == nullptr || addr <= start || addr - start >= (1LL << 32)) {
+      throw std::runtime_error("Object is not in the region of its compressed pointer");
+    }
+
+    compressed_pointer ret;
+    ret.off = addr - start;
+    return ret;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const compressed_pointer &p) {
+    return os << "{offset = " << p.off << "}";
+  }
+};
+
+// Compressed pointers into the default region. SlabAllocator takes a
+// template with a single parameter, so pass this (or an alias of your own)
+// rather than compressed_pointer itself.
+template <typename T>
+using default_compressed_pointer = compressed_pointer<T>;
+
+static_assert(sizeof(compressed_pointer<int>) == 4, "Compressed pointers should be 4 bytes");
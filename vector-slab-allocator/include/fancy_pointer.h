@@ -7,11 +7,15 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <type_traits>
+#include <vector>
 
 #include "slab.h"
+#include "slab_index.h"
 #include "slab_lookup_table.h"
 
 template<typename T>
@@ -65,6 +69,7 @@ struct fancy_pointer {
     , offset(p.offset) {}
 
   static T *to_address(fancy_pointer<T> p) {
+    // Raw (and swizzled) pointers have slab ID 0, which has no slab
     if (slab_lookup_table[p.m_id][p.s_id] == nullptr) {
       return (T*) p.offset;
     } else {
@@ -72,25 +77,79 @@ struct fancy_pointer {
     }
   }
 
-  template<bool V = !std::is_void_v<T>>
-  static fancy_pointer pointer_to(std::enable_if_t<V, T> &r) {
-    // Scan table to find what slab this pointer lives in.
-    for (size_t i = 0; i < sizeof(slab_lookup_table[M_ID]) / sizeof(*slab_lookup_table[M_ID]); ++i) {
-      if (slab_lookup_table[M_ID][i] == nullptr) {
-        continue;
+  // Check if [addr] lives in slab [s] of machine [m]. Returns true and sets
+  // [ret] if it does.
+  static bool in_slab(int m, int s, const void *addr, fancy_pointer<T> &ret) {
+    if (slab_lookup_table[m][s] == nullptr) {
+      return false;
+    }
+
+    Slab *slab = reinterpret_cast<Slab*>(slab_lookup_table[m][s]);
+
+    if (((size_t) slab->blocks) <= ((size_t) addr) &&
+        ((size_t) addr)         <= ((size_t) slab->blocks + slab->size())) {
+      if (slab->swizzled) {
+        // Pointers into the slab are raw addresses, so this one has to be
+        // too for comparisons to work
+        ret = fancy_pointer<T>(0, 0, (size_t) addr);
+      } else {
+        ret = fancy_pointer<T>(m, s, (size_t) addr - (size_t) slab->blocks);
       }
+      return true;
+    }
 
-      Slab *slab = reinterpret_cast<Slab*>(slab_lookup_table[M_ID][i]);
+    return false;
+  }
 
-      if (((size_t) slab->blocks)      <= ((size_t) std::addressof(r)) &&
-          ((size_t) std::addressof(r)) <= ((size_t) slab->blocks + slab->slab_md()->num_blocks * 64*slab->slab_md()->sz)) {
-        return fancy_pointer<T>(M_ID, i, (size_t) std::addressof(r) - (size_t) slab->blocks);
+  // Find the slab of machine [m] that [addr] lives in. Returns true and sets
+  // [ret] if there is one.
+  static bool find_slab(int m, const void *addr, fancy_pointer<T> &ret) {
+    for (int i = 0; i < slab_lookup_table[m].size(); ++i) {
+      if (in_slab(m, i, addr, ret)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // [pointer_to] by comparing [r] against every slab in the slab lookup
+  // table, for addresses that the slab index can't tell apart
+  template<bool V = !std::is_void_v<T>>
+  static fancy_pointer scan_pointer_to(std::enable_if_t<V, T> &r) {
+    fancy_pointer<T> ret;
+
+    // Look in the slabs of this machine first, and then in the slabs adopted
+    // from other machines (e.g. for containers that were received)
+    if (find_slab(M_ID, std::addressof(r), ret)) {
+      return ret;
+    }
+    for (int m = 0; m < MAX_MACHINES; ++m) {
+      if (m != M_ID && find_slab(m, std::addressof(r), ret)) {
+        return ret;
       }
     }
 
     return fancy_pointer<T>(0, 0, (size_t) std::addressof(r));
   }
 
+  // Objects that are not in any slab get the raw form (0, 0, address)
+  template<bool V = !std::is_void_v<T>>
+  static fancy_pointer pointer_to(std::enable_if_t<V, T> &r) {
+    const void *addr = std::addressof(r);
+    uint32_t code = slab_index_lookup(addr);
+
+    if (code == SLAB_INDEX_SHARED) {
+      return scan_pointer_to(r);
+    }
+
+    fancy_pointer<T> ret(0, 0, (size_t) addr);
+    if (code != 0) {
+      in_slab((code - 1) / MAX_SLAB_IDS, (code - 1) % MAX_SLAB_IDS, addr, ret);
+    }
+    return ret;
+  }
+
   explicit operator bool() const { return slab_lookup_table[m_id][s_id] != nullptr || s_id == 0; }
 
   /*
@@ -217,4 +276,47 @@ struct fancy_pointer {
   }
 };
 
+// Resolve the [n] fancy pointers at [in] into [out], with the same results
+// as fancy_pointer::to_address, but with a single lookup in the slab lookup
+// table for each run of pointers into the same slab. Pointers that were
+// collected from a container are mostly into the same slab, so the loop is
+// a load, a compare and an add per pointer.
+template <typename T>
+void to_addresses(const fancy_pointer<T> * __restrict in, std::size_t n,
+                  T ** __restrict out) {
+  static_assert(offsetof(fancy_pointer<T>, s_id) == sizeof(int),
+                "The ids of a fancy pointer should be next to each other");
+
+  // The ids of the current run, compared as one word. The first run is
+  // of null pointers (-1, -1), which hold an address like raw pointers.
+  uint64_t ids = ~0ULL;
+  uintptr_t base = 0;
+
+  for (std::size_t i = 0; i < n; ++i) {
+    uint64_t next_ids;
+    memcpy(&next_ids, &in[i], sizeof(next_ids));
+
+    if (__builtin_expect(next_ids != ids, 0)) {
+      ids = next_ids;
+      int m = in[i].m_id;
+      int s = in[i].s_id;
+
+      // Raw pointers, and pointers into slabs that are not registered, hold
+      // an address
+      base = 0;
+      if (s > 0 && slab_lookup_table[m][s] != nullptr) {
+        base = uintptr_t(reinterpret_cast<Slab*>(slab_lookup_table[m][s])->blocks);
+      }
+    }
+    out[i] = (T*) (base + in[i].offset);
+  }
+}
+
+template <typename T>
+std::vector<T*> to_addresses(const std::vector<fancy_pointer<T>> &ptrs) {
+  std::vector<T*> addrs(ptrs.size());
+  to_addresses(ptrs.data(), ptrs.size(), addrs.data());
+  return addrs;
+}
+
 #endif //FANCY_POINTER_H
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+#include "fancy_pointer.h"
+
+// The operations shared by the alternative pointer types that a
+// SlabAllocator can hand out instead of fancy_pointer (see
+// packed_fancy_pointer.h). [Derived] only has to provide:
+//   T* get() const                      - the address it points to
+//   void advance(difference_type bytes) - move it by [bytes]
+//   static Derived pointer_to(T& r)     - a pointer to [r]
+// and may provide [equals] if it can compare two pointers without
+// resolving them.
+template <typename Derived, typename T>
+struct fancy_pointer_base {
+  typedef std::ptrdiff_t                           difference_type;
+  typedef T                                        value_type;
+  typedef Derived                                  pointer;
+  typedef typename reference_helper<T>::reference  reference;
+  typedef std::random_access_iterator_tag          iterator_category;
+
+  const Derived& derived() const { return static_cast<const Derived&>(*this); }
+  Derived& derived() { return static_cast<Derived&>(*this); }
+
+  static T *to_address(Derived p) { return p.get(); }
+
+  explicit operator bool() const { return derived().get() != nullptr; }
+
+  bool equals(const Derived& rhs) const { return derived().get() == rhs.get(); }
+
+  /*
+   * De-reference operators
+   */
+  T *operator->() const { return derived().get(); }
+  reference operator*() const { return *derived().get(); }
+  reference operator[](std::size_t index) const { return *(derived().get() + index); }
+
+  /*
+   * Equality operators
+   */
+  friend bool operator==(const Derived& lhs, const Derived& rhs) { return lhs.equals(rhs); }
+  friend bool operator!=(const Derived& lhs, const Derived& rhs) { return !lhs.equals(rhs); }
+  friend bool operator==(const Derived& lhs, std::nullptr_t) { return lhs.get() == nullptr; }
+  friend bool operator!=(const Derived& lhs, std::nullptr_t) { return lhs.get() != nullptr; }
+  friend bool operator==(std::nullptr_t, const Derived& rhs) { return rhs.get() == nullptr; }
+  friend bool operator!=(std::nullptr_t, const Derived& rhs) { return rhs.get() != nullptr; }
+
+  /*
+   * Comparison operators
+   */
+  friend bool operator<(const Derived& lhs, const Derived& rhs) { return lhs.get() < rhs.get(); }
+  friend bool operator>(const Derived& lhs, const Derived& rhs) { return rhs.get() < lhs.get(); }
+  friend bool operator<=(const Derived& lhs, const Derived& rhs) { return !(rhs.get() < lhs.get()); }
+  friend bool operator>=(const Derived& lhs, const Derived& rhs) { return !(lhs.get() < rhs.get()); }
+
+  /*
+   * Pre/post increment/decrement
+   */
+  Derived& operator++() {
+    derived().advance(sizeof(T));
+    return derived();
+  }
+
+  Derived operator++(int) {
+    Derived tmp(derived());
+    derived().advance(sizeof(T));
+    return tmp;
+  }
+
+  Derived& operator--() {
+    derived().advance(-difference_type(sizeof(T)));
+    return derived();
+  }
+
+  Derived operator--(int) {
+    Derived tmp(derived());
+    derived().advance(-difference_type(sizeof(T)));
+    return tmp;
+  }
+
+  /*
+   * Pointer arithmetic
+   */
+  Derived& operator+=(difference_type rhs) {
+    derived().advance(rhs * difference_type(sizeof(T)));
+    return derived();
+  }
+
+  Derived& operator-=(difference_type rhs) {
+    derived().advance(-rhs * difference_type(sizeof(T)));
+    return derived();
+  }
+
+  friend Derived operator+(const Derived& lhs, difference_type rhs) {
+    Derived tmp(lhs);
+    tmp += rhs;
+    return tmp;
+  }
+
+  friend Derived operator+(difference_type lhs, const Derived& rhs) {
+    return rhs + lhs;
+  }
+
+  friend Derived operator-(const Derived& lhs, difference_type rhs) {
+    Derived tmp(lhs);
+    tmp -= rhs;
+    return tmp;
+  }
+
+  friend difference_type operator-(const Derived& lhs, const Derived& rhs) {
+    return lhs.get() - rhs.get();
+  }
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "fancy_pointer.h"
+#include "fancy_pointer_base.h"
+#include "slab.h"
+#include "slab_lookup_table.h"
+
+// A fancy pointer packed into 8 bytes, half the size of a fancy_pointer, so
+// that links in node based containers are as small as raw pointers:
+//   bits 63..52: machine id
+//   bits 51..36: slab id
+//   bits 35..0:  offset in the slab, so slabs of up to 64 GiB (pointer_to
+//                throws for objects past that)
+// Objects outside of slabs (which fancy_pointer gives slab id 0) get the
+// machine id RAW_M_ID instead, in which case the 52 low bits are the raw
+// address. A null pointer is the raw address 0.
+// Note: the scans over slabs (swizzling, validation, relocation) only know
+// the layout of fancy_pointer, so they don't see these
+template <typename T>
+struct packed_fancy_pointer
+  : fancy_pointer_base<packed_fancy_pointer<T>, T>
+{
+  using base = fancy_pointer_base<packed_fancy_pointer<T>, T>;
+  using typename base::difference_type;
+
+  static constexpr int S_ID_SHIFT = 36;
+  static constexpr int M_ID_SHIFT = 52;
+  static constexpr uint64_t OFFSET_MASK = (1ULL << S_ID_SHIFT) - 1;
+  static constexpr uint64_t RAW_MASK = (1ULL << M_ID_SHIFT) - 1;
+
+  static constexpr uint64_t RAW_M_ID = (1ULL << (64 - M_ID_SHIFT)) - 1;
+  static constexpr uint64_t NULL_BITS = RAW_M_ID << M_ID_SHIFT;
+
+  static_assert(MAX_MACHINES < RAW_M_ID, "Machine ids don't fit");
+  static_assert(MAX_SLAB_IDS <= (1 << (M_ID_SHIFT - S_ID_SHIFT)), "Slab ids don't fit");
+
+  uint64_t bits;
+
+  packed_fancy_pointer() : bits(NULL_BITS) {}
+
+  packed_fancy_pointer(std::nullptr_t) : bits(NULL_BITS) {}
+
+  packed_fancy_pointer(int m, int s, std::size_t o)
+    : bits((uint64_t(m) << M_ID_SHIFT) | (uint64_t(s) << S_ID_SHIFT) | o) {}
+
+  template<typename U, typename ignore = std::enable_if_t<!std::is_const_v<U> || std::is_const_v<T>>* >
+  packed_fancy_pointer(const packed_fancy_pointer<U> &p) : bits(p.bits) {}
+
+  int m_id() const { return bits >> M_ID_SHIFT; }
+  int s_id() const { return (bits >> S_ID_SHIFT) & ((1 << (M_ID_SHIFT - S_ID_SHIFT)) - 1); }
+  std::size_t offset() const { return bits & OFFSET_MASK; }
+
+  T *get() const {
+    if ((bits >> M_ID_SHIFT) == RAW_M_ID) {
+      return (T*) (bits & RAW_MASK);
+    }
+    return (T*) (reinterpret_cast<Slab*>(slab_lookup_table.entry(m_id(), s_id()).slab)->blocks + offset());
+  }
+
+  // The bits are the same for two pointers to the same object
+  bool equals(const packed_fancy_pointer& rhs) const { return bits == rhs.bits; }
+
+  // Moving within a slab only changes the offset, and moving a raw address
+  // only changes the address
+  void advance(difference_type bytes) { bits += bytes; }
+
+  // Throws for objects whose offset in their slab (or raw address) does not
+  // fit in the bits of a packed pointer
+  template<bool V = !std::is_void_v<T>>
+  static packed_fancy_pointer pointer_to(std::enable_if_t<V, T> &r) {
+    fancy_pointer<T> p = fancy_pointer<T>::pointer_to(r);
+    if (p.s_id == 0) {
+      if (uint64_t(p.offset) > RAW_MASK) {
+        throw std::runtime_error("Address is too wide for a packed fancy pointer");
+      }
+      packed_fancy_pointer ret;
+      ret.bits = NULL_BITS | uint64_t(p.offset);
+      return ret;
+    }
+    if (uint64_t(p.offset) > OFFSET_MASK) {
+      throw std::runtime_error("Offset is too large for a packed fancy pointer");
+    }
+    return packed_fancy_pointer(p.m_id, p.s_id, p.offset);
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const packed_fancy_pointer<T> &p) {
+    return os << "{m_id = " << p.m_id()
+              << "; s_id = " << p.s_id()
+              << "; offset = " << p.offset() << "}";
+  }
+};
+
+static_assert(sizeof(packed_fancy_pointer<int>) == 8, "Packed fancy pointers should be 8 bytes");
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "fancy_pointer.h"
+#include "fancy_pointer_base.h"
+#include "slab.h"
+#include "slab_lookup_table.h"
+
+// Template arguments of pinned_fancy_pointer for its ids:
+// The id is stored in each pointer, like in fancy_pointer
+constexpr int DYNAMIC_ID = -1;
+// The machine id is the one of this process (M_ID)
+constexpr int LOCAL_M_ID = -2;
+// The slab id is the one of the slab that objects of the pointed to type are
+// allocated from one at a time (see size_class_s_id)
+constexpr int SIZE_CLASS_S_ID = -3;
+
+// Slab id of the slab that a SlabAllocator allocates single objects of type
+// [T] from, or DYNAMIC_ID if [T] has no size. A slab asks for this id when
+// it is created (see register_slab), so it only holds for the first
+// allocator with slabs of that size.
+template <typename T>
+constexpr int size_class_s_id() {
+  if constexpr (std::is_void_v<T>) {
+    return DYNAMIC_ID;
+  } else {
+    return log2_int_ceil(sizeof(T)) + 1;
+  }
+}
+
+// One of the ids of a pinned_fancy_pointer, [Which] telling them apart. It
+// is only stored if it is dynamic, so a pinned id takes no space.
+template <int Which, int Id>
+struct pinned_id {
+  static int id() { return (Id == LOCAL_M_ID) ? M_ID : Id; }
+  void set_id(int) {}
+};
+
+template <int Which>
+struct pinned_id<Which, DYNAMIC_ID> {
+  int stored_id;
+  int id() const { return stored_id; }
+  void set_id(int i) { stored_id = i; }
+};
+
+// A fancy pointer whose machine id [M] and/or slab id [S] are fixed at
+// compile time instead of being stored in (and read from) each pointer.
+// With both pinned, a pointer is just an offset, and following it is the
+// offset added to the blocks of a known slot of the slab lookup table.
+// Either id can be DYNAMIC_ID; [M] can be LOCAL_M_ID and [S] can be
+// SIZE_CLASS_S_ID, which pointer_traits keeps when rebinding to another type.
+// SlabAllocator takes a template with a single parameter, so use an alias:
+//   template <typename T>
+//   using node_pointer = pinned_fancy_pointer<T, LOCAL_M_ID, SIZE_CLASS_S_ID>;
+//   SlabAllocator<Node, node_pointer> alloc;
+// Note: pointer_to throws for objects that are not in a pinned slab, such as
+// the sentinel node in a container header, or arrays (with size class slab
+// ids), or objects in swizzled slabs, or in slabs that did not get their
+// size class slab id
+template <typename T, int M = DYNAMIC_ID, int S = DYNAMIC_ID>
+struct pinned_fancy_pointer
+  : fancy_pointer_base<pinned_fancy_pointer<T, M, S>, T>
+  , pinned_id<0, M>
+  , pinned_id<1, (S == SIZE_CLASS_S_ID && std::is_void_v<T>) ? DYNAMIC_ID : S>
+{
+  using base = fancy_pointer_base<pinned_fancy_pointer<T, M, S>, T>;
+  using typename base::difference_type;
+
+  using m_field = pinned_id<0, M>;
+  using s_field = pinned_id<1, (S == SIZE_CLASS_S_ID && std::is_void_v<T>) ? DYNAMIC_ID : S>;
+
+  // pointer_traits can't find these on its own, since [M] and [S] are not
+  // types
+  using element_type = T;
+  template <typename U>
+  using rebind = pinned_fancy_pointer<U, M, S>;
+
+  // Offsets in a slab are never negative
+  static constexpr difference_type NULL_OFFSET = -1;
+
+  difference_type offset;
+
+  pinned_fancy_pointer() : offset(NULL_OFFSET) {}
+
+  pinned_fancy_pointer(std::nullptr_t) : offset(NULL_OFFSET) {}
+
+  pinned_fancy_pointer(int m, int s, difference_type o) : offset(o) {
+    m_field::set_id(m);
+    s_field::set_id(s);
+    assert(m == m_id() && s == s_id() && "Id does not match the pinned id");
+  }
+
+  template<typename U, int M2, int S2,
+           typename ignore = std::enable_if_t<!std::is_const_v<U> || std::is_const_v<T>>* >
+  pinned_fancy_pointer(const pinned_fancy_pointer<U, M2, S2> &p) : offset(p.offset) {
+    m_field::set_id(p.m_id());
+    s_field::set_id(p.s_id());
+    assert((p.offset == NULL_OFFSET || (p.m_id() == m_id() && p.s_id() == s_id())) &&
+           "Id does not match the pinned id");
+  }
+
+  int m_id() const { return m_field::id(); }
+  // The size class is only looked up here, since [T] can still be
+  // incomplete where the pointer is declared (e.g. in [T] itself)
+  int s_id() const {
+    if constexpr (S == SIZE_CLASS_S_ID && !std::is_void_v<T>) {
+      return size_class_s_id<T>();
+    } else {
+      return s_field::id();
+    }
+  }
+
+  T *get() const {
+    if (offset == NULL_OFFSET) {
+      return nullptr;
+    }
+    if constexpr (M == LOCAL_M_ID) {
+      return (T*) (reinterpret_cast<Slab*>(slab_lookup_table.local_entry(s_id()).slab)->blocks + offset);
+    }
+    return (T*) (reinterpret_cast<Slab*>(slab_lookup_table.entry(m_id(), s_id()).slab)->blocks + offset);
+  }
+
+  bool equals(const pinned_fancy_pointer& rhs) const {
+    return offset == rhs.offset && m_id() == rhs.m_id() && s_id() == rhs.s_id();
+  }
+
+  void advance(difference_type bytes) { offset += bytes; }
+
+  template<bool V = !std::is_void_v<T>>
+  static pinned_fancy_pointer pointer_to(std::enable_if_t<V, T> &r) {
+    fancy_pointer<T> p = fancy_pointer<T>::pointer_to(r);
+    pinned_fancy_pointer ret;
+    ret.m_field::set_id(p.m_id);
+    ret.s_field::set_id(p.s_id);
+    if (p.s_id == 0 || p.m_id != ret.m_id() || p.s_id != ret.s_id()) {
+      throw std::runtime_error("Object is not in the slab of its pinned fancy pointer");
+    }
+    ret.offset = p.offset;
+    return ret;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const pinned_fancy_pointer &p) {
+    return os << "{m_id = " << p.m_id()
+              << "; s_id = " << p.s_id()
+              << "; offset = " << p.offset << "}";
+  }
+};
+
+// True if [P] is a pinned_fancy_pointer with size class slab ids, which
+// only point into slabs that have the ids of size_class_s_id
+template <typename P>
+struct pins_size_class_s_id : std::false_type {};
+
+template <typename T, int M>
+struct pins_size_class_s_id<pinned_fancy_pointer<T, M, SIZE_CLASS_S_ID>> : std::true_type {};
+
+static_assert(sizeof(pinned_fancy_pointer<int, LOCAL_M_ID, SIZE_CLASS_S_ID>) == 8,
+              "Pinned fancy pointers should only store their offset");
+static_assert(sizeof(pinned_fancy_pointer<int>) == sizeof(fancy_pointer<int>),
+              "Dynamic ids should be laid out like a fancy pointer");
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include "fancy_pointer_base.h"
+
+// A pointer that stores the distance from its own address to the object it
+// points to, like boost::interprocess::offset_ptr. Following it is a single
+// add, without a slab lookup table access, and the distance stays the same
+// when the slab that holds both the pointer and its object moves (see
+// Slab::resize) or is copied to another machine.
+// Copying a relative_pointer to another address re-encodes the distance, so
+// it is not trivially copyable: objects that hold one must be copied with
+// their copy constructors, not with memcpy.
+// Note: links between different slabs, or from a slab to an object outside
+// of it (e.g. the sentinel node in a container header on the stack), break
+// when either side moves. Use these for links within a slab, or with slabs
+// that never move (e.g. in a SlabSegment).
+template <typename T>
+struct relative_pointer
+  : fancy_pointer_base<relative_pointer<T>, T>
+{
+  using base = fancy_pointer_base<relative_pointer<T>, T>;
+  using typename base::difference_type;
+
+  // Distance from [this] to the object. A pointer can't point into itself
+  // one byte in, so that distance means null.
+  static constexpr std::ptrdiff_t NULL_OFFSET = 1;
+
+  std::ptrdiff_t offset;
+
+  relative_pointer() : offset(NULL_OFFSET) {}
+
+  relative_pointer(std::nullptr_t) : offset(NULL_OFFSET) {}
+
+  relative_pointer(const relative_pointer& p) { set(p.get()); }
+
+  template<typename U, typename ignore = std::enable_if_t<!std::is_const_v<U> || std::is_const_v<T>>* >
+  relative_pointer(const relative_pointer<U> &p) { set(p.get()); }
+
+  relative_pointer& operator=(const relative_pointer& p) {
+    set(p.get());
+    return *this;
+  }
+
+  T *get() const {
+    if (offset == NULL_OFFSET) {
+      return nullptr;
+    }
+    return (T*) (uintptr_t(this) + offset);
+  }
+
+  // Point to [p]. The distance is taken between integers, since [p] and
+  // [this] are usually in different objects, and the compiler may assume
+  // that pointer arithmetic stays within one.
+  void set(const void *p) {
+    offset = (p == nullptr) ? NULL_OFFSET :
+      std::ptrdiff_t(uintptr_t(p) - uintptr_t(this));
+  }
+
+  void advance(difference_type bytes) { offset += bytes; }
+
+  template<bool V = !std::is_void_v<T>>
+  static relative_pointer pointer_to(std::enable_if_t<V, T> &r) {
+    relative_pointer ret;
+    ret.set(std::addressof(r));
+    return ret;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const relative_pointer &p) {
+    return os << "{relative offset = " << p.offset << "}";
+  }
+};
+
+static_assert(sizeof(relative_pointer<int>) == 8, "Relative pointers should be 8 bytes");
@@ -1,9 +1,18 @@
 #pragma once
 
+#include "slab_index.h"
 #include "slab_lookup_table.h"
 
+#include <algorithm>
 #include <array>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
+
+// mmap, ftruncate
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // uint64_t
 #include <cstdint>
@@ -26,12 +35,82 @@ struct SlabMD;
 struct BlockMD;
 struct Block;
 
+// Slab ID that a new slab is registered under, which has to be free (e.g.
+// in a range from reserve_slab_ids), or 0 to let the slab pick one
+struct SlabId {
+  int s_id = 0;
+};
+
 struct Slab {
   // A resize-able list of blocks
   char *blocks;
 
-  // Create a slab of 1 block, where each slot in the block is [s] bytes
-  Slab(size_t s);
+  // Where this slab is registered in the slab lookup table
+  int m_id;
+  int s_id;
+
+  // False if [blocks] belongs to someone else (e.g. a receive buffer)
+  bool owns_blocks;
+
+  // File that [blocks] is a shared mapping of, or -1 if [blocks] is on the
+  // heap
+  int fd;
+
+  // Number of bytes reserved at [blocks], so that the slab can grow in place
+  // instead of moving, or 0 if nothing is reserved
+  size_t capacity = 0;
+
+  // True if [blocks] is an anonymous mapping of [capacity] bytes that this
+  // slab reserved (see SLAB_RESERVE_SZ), of which only the pages holding
+  // blocks are accessible. Otherwise the memory at [capacity] is all mapped
+  // already (e.g. by a SlabSegment).
+  bool reserved = false;
+
+  // True while the fancy pointers into this slab are swizzled to raw
+  // addresses (see slab_swizzle.h)
+  bool swizzled = false;
+
+  // Bitmap of the blocks that were written to since the last call to
+  // [clear_dirty]. Allocating and freeing mark blocks dirty automatically;
+  // writes to objects that are already allocated have to be marked with
+  // [mark_dirty].
+  std::vector<uint64_t> dirty;
+
+  // Range of addresses that this slab added to the slab index, guarded by
+  // [slab_index_mux]
+  char *indexed = nullptr;
+  size_t indexed_len = 0;
+
+  // Create a slab of 1 block, where each slot in the block is [s] bytes.
+  // It is registered under slab ID [id], or else under a slab ID of its own
+  // (see register_slab).
+  Slab(size_t s, SlabId id = SlabId());
+
+  // Create a slab whose blocks are a shared mapping of the file [f], so that
+  // the contents of the slab outlive the process. If the file is empty, a
+  // slab of 1 block is created in it, where each slot in the block is [s]
+  // bytes. Otherwise the file must hold a slab with [s] byte slots, which is
+  // reopened as is.
+  // The slab takes ownership of [f], and is registered like above.
+  Slab(size_t s, int f, SlabId id = SlabId());
+
+  // Create a slab over blocks that were initialized elsewhere (e.g. received
+  // from machine [m]), and register it as slab [s] of machine [m], which
+  // must not be in use (see register_slab_at).
+  // [b] is not freed when this slab is destroyed.
+  // Note: the blocks may not be filled in yet, so call [index] once they are
+  Slab(char *b, int m, int s);
+
+  Slab(const Slab&) = delete;
+  Slab& operator=(const Slab&) = delete;
+
+  // Unregister this slab, and free its blocks if it owns them
+  ~Slab();
+
+  // Remove this slab from the slab lookup table and the slab index, unless
+  // something else was registered under its slab ID since, so that fancy
+  // pointers into it are no longer followed
+  void unregister();
 
   // Get the metadata for this slab
   SlabMD* slab_md();
@@ -56,6 +135,39 @@ struct Slab {
 
   // Helper function to resize [blocks] once it gets full
   void resize();
+
+  // Flush the blocks to the file backing this slab (if there is one)
+  void sync();
+
+  // Size of [blocks] in bytes
+  size_t size();
+
+  // Check if nothing is allocated in the [n]th block
+  bool is_block_empty(int n);
+
+  // Check if the [n]th block was written to since the last [clear_dirty]
+  bool is_dirty(int n);
+
+  // Mark the [n]th block as written to
+  void mark_dirty_block(int n);
+
+  // Mark the block that [p] (which points into [blocks]) lives in as
+  // written to
+  void mark_dirty(void* p);
+
+  // Mark the [n]th block as clean
+  void clear_dirty_block(int n);
+
+  // Mark every block as clean
+  void clear_dirty();
+
+  // Add the blocks (or the memory reserved for them) to the slab index, in
+  // place of what was added before. Has to be called whenever the blocks
+  // move or grow.
+  void index();
+
+  // Remove this slab from the slab index
+  void unindex();
 };
 
 struct SlabMD {
@@ -68,11 +180,15 @@ struct SlabMD {
   // Bitmap showing which blocks are free (for the first 64 blocks)
   uint64_t free_block_list;
 
-  SlabMD(int s) : sz(s), num_blocks(1), free_block_list(-1ULL)
+  // Offset in the slab of the SlabRootTable of its machine, or 0 if the
+  // table is not in this slab (see slab_roots.h)
+  uint64_t roots;
+
+  SlabMD(int s) : sz(s), num_blocks(1), free_block_list(-1ULL), roots(0)
   { }
 
   SlabMD(int s, int n, uint64_t fl = -1ULL)
-    : sz(s), num_blocks(n), free_block_list(fl)
+    : sz(s), num_blocks(n), free_block_list(fl), roots(0)
   { }
 };
 
@@ -97,7 +213,8 @@ struct BlockMD {
     : start(s), free_slot_list(-1ULL)
   {
     // Mark, as not-free, the slots that have metadata
-    int num_taken = std::max(1UL, md_sz / s->slab_md()->sz);
+    size_t sz = s->slab_md()->sz;
+    int num_taken = (md_sz + sz - 1) / sz;
     for (int i = 0; i < num_taken; ++i) {
       bit_clear(free_slot_list, i+1);
     }
@@ -155,10 +272,12 @@ struct Block {
 
   // Returns a pair [(p, full)] where:
   // - [p] is a pointer to the slot in the block, where (at most)
-  //   [slab_md()->sz] bytes can be stored
+  //   [sz] bytes can be stored
   // - [full] is true if the block is full (i.e. no more free slots),
   //   and false otherwise
-  std::pair<void*, bool> find_free_slot() {
+  // Note: [sz] is passed in rather than found through [block_md()->start],
+  // since [start] is only valid in the process that initialized the block
+  std::pair<void*, bool> find_free_slot(size_t sz) {
     // Note: returns the position as 1-indexed from the right (LSB)
     BlockMD *bmd = this->block_md();
     int free_slot_pos = ffsll(bmd->free_slot_list);
@@ -166,7 +285,7 @@ struct Block {
 
     bit_clear(bmd->free_slot_list, free_slot_pos);
 
-    void *ret = &data[0] + (free_slot_pos - 1)*get_slot_sz();
+    void *ret = &data[0] + (free_slot_pos - 1)*sz;
 
     return {ret, is_full()};
   }
@@ -181,6 +300,76 @@ constexpr size_t round_pow2(size_t sz) {
   return rounded_size;
 }
 
+// Round up to a multiple of the page size
+size_t round_page(size_t n) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  return (n + page - 1) / page * page;
+}
+
+// Bytes of address space that a slab on the heap reserves up front, so that
+// it can grow in place for a long time before it has to move. Only the
+// pages that hold blocks take up memory.
+constexpr size_t SLAB_RESERVE_SZ = size_t(1) << 30;
+
+// Reserve [len] bytes of address space, which can't be accessed yet, at an
+// address that is aligned to [align] bytes, since mmap only guarantees page
+// alignment. Returns nullptr if there is not enough address space.
+char* reserve_aligned(size_t len, size_t align) {
+  len = round_page(len);
+  align = round_page(align);
+
+  // Reserve enough address space to be able to align the range
+  char *reserved = static_cast<char*>(mmap(nullptr, len + align, PROT_NONE,
+                                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                                           -1, 0));
+  if (reserved == MAP_FAILED) {
+    return nullptr;
+  }
+
+  char *aligned = reinterpret_cast<char*>
+    ((uintptr_t(reserved) + align - 1) & ~(uintptr_t(align) - 1));
+
+  // Give back the unused address space on either side of the range
+  if (aligned != reserved) {
+    munmap(reserved, aligned - reserved);
+  }
+  if (aligned + len != reserved + len + align) {
+    munmap(aligned + len, (reserved + len + align) - (aligned + len));
+  }
+
+  return aligned;
+}
+
+// Make the pages of the first [len] bytes of the range [start] (from
+// reserve_aligned) accessible, from [from] bytes on. The pages before
+// [from] already are.
+void commit_reserved(char *start, size_t from, size_t len) {
+  from = round_page(from);
+  len = round_page(len);
+  if (len > from && mprotect(start + from, len - from, PROT_READ | PROT_WRITE) != 0) {
+    throw std::runtime_error("Could not commit memory for a slab");
+  }
+}
+
+// Map [len] bytes of the file [fd] as shared memory at an address that is
+// aligned to [align] bytes
+char* map_aligned(int fd, size_t len, size_t align) {
+  len = round_page(len);
+
+  char *aligned = reserve_aligned(len, align);
+  if (aligned == nullptr) {
+    throw std::runtime_error("Could not reserve address space for a slab");
+  }
+
+  if (mmap(aligned, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0)
+      == MAP_FAILED) {
+    munmap(aligned, len);
+    throw std::runtime_error("Could not map the file of a slab");
+  }
+
+  return aligned;
+}
+
 // Compute ceil(log_2(n))
 constexpr size_t log2_int_ceil(size_t n) {
   size_t rounded_size = 1;
@@ -193,16 +382,282 @@ constexpr size_t log2_int_ceil(size_t n) {
 }
 
 
-Slab::Slab(size_t s)
+// Register [slab], with [s] byte slots, under slab ID [id] of this machine
+// (see Slab::Slab). Returns the slab ID.
+int register_new_slab(Slab *slab, size_t s, SlabId id) {
+  if (id.s_id > 0) {
+    return register_slab_at(M_ID, id.s_id, reinterpret_cast<char*>(slab));
+  }
+  return register_slab(M_ID, reinterpret_cast<char*>(slab), log2_int_ceil(s) + 1);
+}
+
+Slab::Slab(size_t s, SlabId id)
 {
   assert(s == round_pow2(s) && "Slabs can only have sizes of powers of 2");
 
-  posix_memalign((void**)&blocks, 64*s, 64*s);
+  // Reserve room to grow in place, and fall back to the heap if there is
+  // not enough address space (e.g. under ulimit -v)
+  capacity = std::max(SLAB_RESERVE_SZ, round_page(64*s));
+  blocks = reserve_aligned(capacity, 64*s);
+  if (blocks != nullptr) {
+    reserved = true;
+    try {
+      commit_reserved(blocks, 0, 64*s);
+    } catch (...) {
+      munmap(blocks, capacity);
+      throw;
+    }
+  } else {
+    capacity = 0;
+    if (posix_memalign((void**)&blocks, 64*s, 64*s) != 0) {
+      throw std::bad_alloc();
+    }
+  }
+
+  auto release_blocks = [this]() {
+    if (reserved) {
+      munmap(blocks, capacity);
+    } else {
+      free(blocks);
+    }
+  };
 
   nth_block(0)->initialize_head(this, s);
 
-  slab_lookup_table[M_ID][log2_int_ceil(this->slab_md()->sz) + 1] =
-    reinterpret_cast<char*>(this);
+  m_id = M_ID;
+  try {
+    s_id = register_new_slab(this, s, id);
+  } catch (...) {
+    release_blocks();
+    throw;
+  }
+  owns_blocks = true;
+  fd = -1;
+
+  try {
+    mark_dirty_block(0);
+    index();
+  } catch (...) {
+    unregister_slab(m_id, s_id, reinterpret_cast<char*>(this));
+    release_blocks();
+    throw;
+  }
+}
+
+Slab::Slab(size_t s, int f, SlabId id)
+  : fd(f)
+{
+  assert(s == round_pow2(s) && "Slabs can only have sizes of powers of 2");
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("Could not stat the file of a slab");
+  }
+
+  bool reopen = st.st_size > 0;
+  size_t len = reopen ? st.st_size : 64*s;
+
+  if (!reopen && ftruncate(fd, len) != 0) {
+    close(fd);
+    throw std::runtime_error("Could not grow the file of a slab");
+  }
+
+  try {
+    blocks = map_aligned(fd, len, 64*s);
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+
+  if (reopen) {
+    if (size_t(slab_md()->sz) != s ||
+        size_t(slab_md()->num_blocks) * 64*s != len) {
+      munmap(blocks, round_page(len));
+      close(fd);
+      throw std::runtime_error("File does not hold a slab of this size");
+    }
+
+    // The block metadata still points back at the Slab of the process that
+    // wrote the file, so point it at this one instead
+    for (int i = 0; i < slab_md()->num_blocks; ++i) {
+      nth_block(i)->block_md()->start = this;
+    }
+  } else {
+    nth_block(0)->initialize_head(this, s);
+  }
+
+  m_id = M_ID;
+  try {
+    s_id = register_new_slab(this, s, id);
+  } catch (...) {
+    munmap(blocks, round_page(len));
+    close(fd);
+    throw;
+  }
+  owns_blocks = true;
+
+  try {
+    for (int i = 0; i < slab_md()->num_blocks; ++i) {
+      mark_dirty_block(i);
+    }
+    index();
+  } catch (...) {
+    unregister_slab(m_id, s_id, reinterpret_cast<char*>(this));
+    munmap(blocks, round_page(len));
+    close(fd);
+    throw;
+  }
+}
+
+Slab::Slab(char *b, int m, int s)
+  : blocks(b), m_id(m), s_id(s), owns_blocks(false), fd(-1)
+{
+  assert(0 <= m && m < MAX_MACHINES && 0 < s && s < MAX_SLAB_IDS &&
+         "Slab ID out of range");
+
+  register_slab_at(m_id, s_id, reinterpret_cast<char*>(this));
+}
+
+Slab::~Slab() {
+  unregister();
+
+  if (fd >= 0) {
+    munmap(blocks, round_page(size()));
+    close(fd);
+  } else if (reserved) {
+    munmap(blocks, capacity);
+  } else if (owns_blocks) {
+    free(blocks);
+  }
+}
+
+void Slab::unregister() {
+  if (unregister_slab(m_id, s_id, reinterpret_cast<char*>(this))) {
+    unindex();
+  }
+}
+
+// Forget the slabs of machine [m], e.g. because it left the cluster, so
+// that fancy pointers into them resolve to their offset, like pointers into
+// slabs that are not registered. This takes a single store, however many
+// slabs the machine has. The row of [m] is released once no SlabReadGuard
+// can still be reading it, while the slabs themselves belong to whatever
+// adopted them (see AdoptedSlabImage, SlabReplica and SharedSlabs).
+void evict_machine(int m) {
+  if (m == M_ID) {
+    throw std::runtime_error("This machine can't be evicted");
+  }
+
+  SlabTableRow *row = take_slab_row(m);
+  if (row == nullptr) {
+    return;
+  }
+
+  for (int s = 0; s < row->size(); ++s) {
+    Slab *slab = reinterpret_cast<Slab*>((*row)[s]);
+    if (slab != nullptr) {
+      slab->unindex();
+    }
+  }
+  retire_slab_memory([row]() { delete row; });
+}
+
+size_t Slab::size() {
+  return size_t(slab_md()->num_blocks) * 64*slab_md()->sz;
+}
+
+void Slab::sync() {
+  if (fd >= 0) {
+    msync(blocks, size(), MS_SYNC);
+  }
+}
+
+bool Slab::is_block_empty(int n) {
+  // An empty block only has the slots holding its metadata taken
+  size_t md_sz = (n == 0) ? sizeof(Metadata::all_md) : sizeof(BlockMD);
+  return nth_block(n)->block_md()->free_slot_list ==
+    BlockMD(this, md_sz).free_slot_list;
+}
+
+bool Slab::is_dirty(int n) {
+  return size_t(n / 64) < dirty.size() && (dirty[n / 64] & (1ULL << (n % 64)));
+}
+
+void Slab::mark_dirty_block(int n) {
+  if (size_t(n / 64) >= dirty.size()) {
+    dirty.resize(n / 64 + 1, 0);
+  }
+  bit_set(dirty[n / 64], n % 64 + 1);
+}
+
+void Slab::mark_dirty(void* p) {
+  mark_dirty_block((static_cast<char*>(p) - blocks) / (64*slab_md()->sz));
+}
+
+void Slab::clear_dirty_block(int n) {
+  if (size_t(n / 64) < dirty.size()) {
+    bit_clear(dirty[n / 64], n % 64 + 1);
+  }
+}
+
+void Slab::clear_dirty() {
+  std::fill(dirty.begin(), dirty.end(), 0);
+}
+
+void Slab::index() {
+  // A reserved slab only adds the blocks that it has, since it is the one
+  // that grows into the rest of the reservation
+  size_t len = reserved ? size() : std::max(capacity, size());
+  if (blocks == indexed && len == indexed_len) {
+    return;
+  }
+
+  // Growing in place only adds granules, which lookups that are going on
+  // can keep using
+  if (blocks == indexed && len > indexed_len) {
+    std::lock_guard<std::mutex> lock(slab_index_mux);
+    slab_index_add(m_id, s_id, blocks, len);
+    indexed_len = len;
+    return;
+  }
+
+  // Note: the blocks only move while the slab is being resized, when they
+  // can't be used anyway
+  unindex();
+
+  std::lock_guard<std::mutex> lock(slab_index_mux);
+  slab_index_add(m_id, s_id, blocks, len);
+  indexed = blocks;
+  indexed_len = len;
+}
+
+void Slab::unindex() {
+  if (indexed == nullptr) {
+    return;
+  }
+
+  // Other slabs that are registered may still share some granules
+  auto recount = [this](uintptr_t g) {
+    uint32_t entry = 0;
+    for (int m = 0; m < MAX_MACHINES; ++m) {
+      for (int s = 0; s < slab_lookup_table[m].size(); ++s) {
+        Slab *other = reinterpret_cast<Slab*>(slab_lookup_table[m][s]);
+        if (other == nullptr || other == this || other->indexed == nullptr ||
+            uintptr_t(other->indexed) >= g + (1ULL << SLAB_INDEX_SHIFT) ||
+            uintptr_t(other->indexed) + other->indexed_len < g) {
+          continue;
+        }
+        entry = (entry == 0) ? slab_index_code(m, s) : SLAB_INDEX_SHARED;
+      }
+    }
+    return entry;
+  };
+
+  std::lock_guard<std::mutex> lock(slab_index_mux);
+  slab_index_remove(m_id, s_id, indexed, indexed_len, recount);
+  indexed = nullptr;
+  indexed_len = 0;
 }
 
 Block* Slab::nth_block(size_t n) {
@@ -231,7 +686,8 @@ std::tuple<void*, bool, void*> Slab::allocate() {
     // through the remaining blocks to see if there is a free block
     for (int i = 64; i < this->slab_md()->num_blocks; ++i) {
       if (!nth_block(i)->is_full()) {
-        std::tie(ret, is_full) = nth_block(i)->find_free_slot();
+        std::tie(ret, is_full) = nth_block(i)->find_free_slot(this->slab_md()->sz);
+        mark_dirty_block(i);
         break;
       }
     }
@@ -246,7 +702,8 @@ std::tuple<void*, bool, void*> Slab::allocate() {
     }
   } else {
     // Found a free block in the free_block_list
-    std::tie(ret, is_full) = nth_block(free_block_pos - 1)->find_free_slot();
+    std::tie(ret, is_full) = nth_block(free_block_pos - 1)->find_free_slot(this->slab_md()->sz);
+    mark_dirty_block(free_block_pos - 1);
 
     // Only clear bits in the free_block_list for blocks found
     // in the free block list
@@ -271,11 +728,14 @@ void Slab::deallocate(void* p) {
   Block *blk = reinterpret_cast<Block*>
     (static_cast<char*>(p) - slot_num*sz);
 
-  Slab *slab = blk->block_md()->start;
+  // Note: [blk->block_md()->start] is only valid in the process that
+  // initialized the block, and [p] belongs to this slab anyway
+  Slab *slab = this;
 
   int block_num = ((uint64_t(blk)) - (uint64_t(slab->blocks))) / (64*sz);
 
   bit_set(blk->block_md()->free_slot_list, slot_num + 1);
+  slab->mark_dirty_block(block_num);
   bit_set(slab->slab_md()->free_block_list, block_num + 1);
 }
 
@@ -284,19 +744,52 @@ void Slab::resize() {
   int old_num_blocks = this->slab_md()->num_blocks;
   int new_num_blocks = 2 * old_num_blocks;
 
+  size_t old_size = size_t(old_num_blocks) * 64*sz;
+  size_t new_size = size_t(new_num_blocks) * 64*sz;
   char *new_blocks;
 
-  posix_memalign((void**)&new_blocks,
-                 64*sz,
-                 new_num_blocks * 64*sz);
+  if (new_size <= capacity) {
+    // Grow into the memory reserved after the blocks, which only has to be
+    // made accessible if this slab reserved it. The blocks don't move, so
+    // raw pointers into them stay valid.
+    if (reserved) {
+      commit_reserved(blocks, old_size, new_size);
+    }
+
+    new_blocks = blocks;
+  } else if (capacity > 0 && !reserved) {
+    throw std::runtime_error("Slab has no room left to grow");
+  } else if (fd >= 0) {
+    // Grow the file, and map all of it. The old blocks are already in the
+    // file, so nothing needs to be copied.
+    if (ftruncate(fd, new_size) != 0) {
+      throw std::runtime_error("Could not grow the file of a slab");
+    }
+
+    new_blocks = map_aligned(fd, new_size, 64*sz);
 
-  // Copy all old blocks into new one
-  memcpy(new_blocks, blocks, old_num_blocks * 64*sz);
+    munmap(blocks, round_page(old_size));
+  } else {
+    if (posix_memalign((void**)&new_blocks, 64*sz, new_size) != 0) {
+      throw std::bad_alloc();
+    }
 
-  // Free the old blocks
-  free(blocks);
+    // Copy all old blocks into new one
+    memcpy(new_blocks, blocks, old_size);
+
+    // Free the old blocks. A slab that outgrew its reservation stays on the
+    // heap from now on.
+    if (reserved) {
+      munmap(blocks, capacity);
+      reserved = false;
+      capacity = 0;
+    } else {
+      free(blocks);
+    }
+  }
 
   // Update the blocks in the Slab to now be the new blocks
+  bool moved = new_blocks != blocks;
   blocks = new_blocks;
 
   // Update the number of blocks in the old blocks
@@ -305,8 +798,12 @@ void Slab::resize() {
   // Initialize all the new blocks we created
   for (int i = old_num_blocks; i < new_num_blocks; ++i) {
     this->nth_block(i)->initialize_tail(this);
+    mark_dirty_block(i);
   }
 
-  slab_lookup_table[M_ID][log2_int_ceil(this->slab_md()->sz) + 1] =
-    reinterpret_cast<char*>(this);
+  // Only moving invalidates the blocks cached by other threads
+  if (moved) {
+    bump_slab_generation(m_id, s_id);
+  }
+  index();
 }
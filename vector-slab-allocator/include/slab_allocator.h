@@ -1,33 +1,517 @@
 #pragma once
 
 #include "slab.h"
+#include "slab_image.h"
+#include "slab_share.h"
+#include "slab_segment.h"
+#include "slab_stream.h"
+#include "slab_roots.h"
+#include "slab_snapshot.h"
+#include "slab_swizzle.h"
+#include "slab_validate.h"
+#include "slab_relocate.h"
 #include "fancy_pointer.h"
+#include "packed_fancy_pointer.h"
+#include "compressed_pointer.h"
+#include "relative_pointer.h"
+#include "pinned_fancy_pointer.h"
+#include "cached_fancy_pointer.h"
+#include "slab_prefetch.h"
+
+#include <memory>
+#include <string>
+#include <type_traits>
+
+// open
+#include <fcntl.h>
 
 // Computes 2^p
 constexpr size_t pow2(size_t p) {
   return 1UL << p;
 }
 
+// Tag to create an allocator whose slabs can be shared with other processes
+// on the same host (see SlabAllocatorInternal::share_slabs)
+struct memfd_backed_t {
+  explicit memfd_backed_t() = default;
+};
+constexpr memfd_backed_t memfd_backed{};
+
+// Tag to create an allocator that allocates from a SlabSegment, together
+// with allocators in other processes that map the same segment
+struct shared_segment_t {
+  explicit shared_segment_t() = default;
+};
+constexpr shared_segment_t shared_segment{};
+
 // Internal data for a slab allocator
 struct SlabAllocatorInternal {
-  // Allows for slabs with slot size up to 2 << MAX_SLABS bytes
-  static int constexpr MAX_SLABS = 40;
+  // Allows for slabs with slot size up to 2 << MAX_SLABS bytes, which is as
+  // many slabs as there are IDs in a range (see reserve_slab_ids)
+  static int constexpr MAX_SLABS = SLAB_SIZE_CLASSES;
 
-  std::array<Slab*, MAX_SLABS> slabs;
+  std::array<Slab*, MAX_SLABS> slabs{};
 
   std::mutex mux_slabs;
 
+  // Directory with one file per slab, or empty if the slabs are on the heap
+  std::string dir;
+
+  // True if the slabs are anonymous shared memory files (see memfd_create)
+  bool memfd = false;
+
+  // The segment that the slabs live in, if they are shared with allocators
+  // in other processes. Declared after [slabs], so that the slabs are
+  // unregistered before the segment is unmapped.
+  std::unique_ptr<SlabSegment> segment;
+
+  // Detaches [segment] from the region of compressed pointers that it was
+  // attached to, if any (see make_compressed_allocator)
+  void (*detach_segment)(SlabSegment&) = nullptr;
+
+  // Where complete blocks are streamed to while they are being allocated
+  // from, or null if they are not streamed (see [stream_to])
+  std::unique_ptr<SlabStream> stream;
+
+  // The range of slab IDs of this allocator, which starts at [id_base] in
+  // the row of machine [id_m_id] (see reserve_slab_ids), so that pointers
+  // into its slabs never alias pointers into the slabs of other allocators.
+  // The slabs of a slab segment have the fixed IDs exp + 1 of the machine
+  // of the segment, so its allocator reserves exactly that range.
+  int id_m_id = M_ID;
+  int id_base = reserve_slab_ids(id_m_id);
+
+  SlabAllocatorInternal() = default;
+
+  // Create the slabs as anonymous shared memory files, so that they can be
+  // shared with other processes on this host
+  explicit SlabAllocatorInternal(memfd_backed_t) : memfd(true) {}
+
+  // Create the slabs as files in [d], so that their contents survive
+  // restarts. Slabs that a previous process left in [d] are reopened, and
+  // registered in the slab lookup table again under the IDs they had, so
+  // fancy pointers that were stored in them are valid right away. The
+  // range of slab IDs is kept in [d] as well, and reserved again; this
+  // throws if the range is taken (e.g. by an allocator created before this
+  // one), or if the machine id is not the one of the previous process.
+  explicit SlabAllocatorInternal(std::string d)
+    : dir(std::move(d))
+    , id_base(reserve_persisted_slab_ids())
+  {
+    try {
+      for (int exp = 0; exp < MAX_SLABS; ++exp) {
+        int fd = open(slab_path(exp).c_str(), O_RDWR);
+        if (fd >= 0) {
+          slabs[exp] = new Slab(pow2(exp), fd, slab_id(exp));
+        }
+      }
+    } catch (...) {
+      for (Slab* slab : slabs) {
+        delete slab;
+      }
+      release_slab_ids(id_m_id, id_base);
+      throw;
+    }
+  }
+
+  // Allocate from the slab segment in the shared memory file [fd], along
+  // with every other process that maps it. If [fd] is empty, a segment is
+  // created in it for machine [m_id] (see SlabSegment). [mux_slabs] only
+  // guards this process; the segment has locks of its own.
+  SlabAllocatorInternal(shared_segment_t, int fd, int m_id = -1,
+                        size_t region_sz = SLAB_SEGMENT_REGION_SZ)
+    : segment(new SlabSegment(fd, m_id, region_sz))
+    , id_m_id(segment->header->m_id)
+    , id_base(reserve_slab_ids_at(id_m_id, 0))
+  {
+    // Register every slab up front, so that pointers allocated by other
+    // processes can be followed before this process allocates anything
+    for (int exp = 0; exp < MAX_SLABS; ++exp) {
+      if (segment->fits(exp)) {
+        slabs[exp] = segment->attach(exp);
+      }
+    }
+  }
+
+  // Path of the file for the slab with [2^exp] byte slots
+  std::string slab_path(size_t exp) {
+    return dir + "/slab_" + std::to_string(exp);
+  }
+
+  // Path of the file with the machine id and the range of slab IDs of the
+  // slabs in [dir]
+  std::string ids_path() {
+    return dir + "/slab_ids";
+  }
+
+  // Reserve the range of slab IDs that the slabs in [dir] have, or a new
+  // range if there are none yet, which is then written to [dir]. Returns
+  // the start of the range.
+  int reserve_persisted_slab_ids() {
+    int ids[2];
+    int fd = open(ids_path().c_str(), O_RDONLY);
+    if (fd >= 0) {
+      ssize_t n = read(fd, ids, sizeof(ids));
+      close(fd);
+      if (n != sizeof(ids)) {
+        throw std::runtime_error("Could not read the slab IDs of a slab directory");
+      }
+      if (ids[0] != id_m_id) {
+        throw std::runtime_error("Slab directory belongs to another machine id");
+      }
+      return reserve_slab_ids_at(id_m_id, ids[1]);
+    }
+
+    ids[0] = id_m_id;
+    ids[1] = reserve_slab_ids(id_m_id);
+    fd = open(ids_path().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, ids, sizeof(ids)) != sizeof(ids) || fsync(fd) != 0) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      release_slab_ids(id_m_id, ids[1]);
+      throw std::runtime_error("Could not write the slab IDs of a slab directory");
+    }
+    close(fd);
+    return ids[1];
+  }
+
+  // Slab ID of the slab with [2^exp] byte slots
+  SlabId slab_id(size_t exp) {
+    return SlabId{id_base + int(exp) + 1};
+  }
+
+  // True if every slab has the ID that size_class_s_id gives it, which
+  // is the case for the first range of slab IDs (and so for the slabs of
+  // a slab segment)
+  bool has_size_class_ids() const {
+    return id_base == 0;
+  }
+
+  // Create the slab with [2^exp] byte slots
+  Slab* make_slab(size_t exp) {
+    if (memfd) {
+      int fd = memfd_create(("slab_" + std::to_string(exp)).c_str(), MFD_CLOEXEC);
+      if (fd < 0) {
+        throw std::runtime_error("Could not create the shared memory for a slab");
+      }
+      return new Slab(pow2(exp), fd, slab_id(exp));
+    }
+
+    if (dir.empty()) {
+      return new Slab(pow2(exp), slab_id(exp));
+    }
+
+    int fd = open(slab_path(exp).c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Could not create the file for a slab");
+    }
+    return new Slab(pow2(exp), fd, slab_id(exp));
+  }
+
+  // Get the slab with [2^exp] byte slots, creating it the first time it is
+  // needed
+  Slab* get_slab(size_t exp) {
+    if (segment) {
+      if (slabs[exp] == nullptr) {
+        throw std::runtime_error("Tried to allocate an object that was too large for the slab segment");
+      }
+      segment->initialize(slabs[exp], exp);
+      return slabs[exp];
+    }
+
+    // Uses double-checked locking paradigm
+    // TODO: Replace lock with atomic bool
+    if (slabs[exp] == nullptr) {
+      std::lock_guard<std::mutex> lock(mux_slabs);
+      if (slabs[exp] == nullptr) {
+        slabs[exp] = make_slab(exp);
+      }
+    }
+    return slabs[exp];
+  }
+
+  // Allocate a slot from the slab with [2^exp] byte slots. In a segment,
+  // other processes allocate from the same slab, so the slab is locked.
+  void* allocate_slot(size_t exp) {
+    Slab* slab = get_slab(exp);
+    if (segment) {
+      SegmentLock lock(&segment->header->mux[exp]);
+      return std::get<0>(slab->allocate());
+    }
+
+    void *p = std::get<0>(slab->allocate());
+
+    if (stream) {
+      int n = (static_cast<char*>(p) - slab->blocks) / (64*pow2(exp));
+      if (slab->nth_block(n)->is_full()) {
+        stream->block_full(slab, n);
+      }
+    }
+    return p;
+  }
+
+  // Free the slot [p] of the slab with [2^exp] byte slots
+  void deallocate_slot(size_t exp, void* p) {
+    Slab* slab = slabs[exp];
+    if (segment) {
+      SegmentLock lock(&segment->header->mux[exp]);
+      slab->deallocate(p);
+      return;
+    }
+    slab->deallocate(p);
+  }
+
+  // Flush the slabs to their files (if they have any)
+  void sync() {
+    for (Slab* slab : slabs) {
+      if (slab != nullptr) {
+        slab->sync();
+      }
+    }
+  }
+
+  // Describe every slab of this allocator as a scatter-gather list, which
+  // can be handed to writev/sendmsg without staging copies.
+  // Note: no allocations may happen until the image has been sent, since an
+  // allocation can resize (and so move) a slab
+  SlabImage export_slabs() {
+    std::lock_guard<std::mutex> lock(mux_slabs);
+    SlabImage image = make_slab_image(slabs);
+    clear_dirty();
+    return image;
+  }
+
+  // Like [export_slabs], but throw instead if the slabs hold raw fancy
+  // pointers where [layouts] place fancy pointers (see slab_relocate.h),
+  // which would not be valid on the receiver. [relocate_into_slab] fixes the
+  // usual culprit, a container header that is not in a slab.
+  SlabImage export_checked(const std::vector<SlabPointerLayout>& layouts) {
+    std::lock_guard<std::mutex> lock(mux_slabs);
+    std::vector<RawPointerRef> refs = ::find_raw_pointers(slabs, layouts);
+    if (!refs.empty()) {
+      throw std::runtime_error("Slabs hold " + std::to_string(refs.size()) +
+                               " raw fancy pointer(s), e.g. to address " +
+                               std::to_string(refs[0].address));
+    }
+    SlabImage image = make_slab_image(slabs);
+    clear_dirty();
+    return image;
+  }
+
+  // Find the raw fancy pointers that [layouts] place in the slabs
+  std::vector<RawPointerRef> find_raw_pointers(const std::vector<SlabPointerLayout>& layouts) {
+    std::lock_guard<std::mutex> lock(mux_slabs);
+    return ::find_raw_pointers(slabs, layouts);
+  }
+
+  // Move the object [obj], which is not in a slab, into a slab, and return
+  // the new object, which the caller should use from then on in place of
+  // [obj]. It is move constructed, so a container whose header is moved
+  // points its nodes at the new header itself. Raw fancy pointers into
+  // [obj] that are left where [layouts] place fancy pointers in the slabs
+  // (e.g. in nodes that link to a sentinel that was copied) are pointed at
+  // the new object too.
+  // Note: [obj] is left in its moved-from state, and still belongs to the
+  // caller, who destroys it as usual. The new object is destroyed and
+  // deallocated like any other object in the slabs. Pointers to [obj] that
+  // are not in the slabs are not updated.
+  template <typename T>
+  fancy_pointer<T> relocate_into_slab(T *obj,
+                                      const std::vector<SlabPointerLayout>& layouts = {}) {
+    static_assert(std::is_move_constructible_v<T>,
+                  "Only objects that can be moved can be relocated into a slab");
+
+    size_t exp = log2_int_ceil(sizeof(T));
+    if (exp >= MAX_SLABS) {
+      throw std::runtime_error("Tried to relocate an object that was too large");
+    }
+
+    void *p = allocate_slot(exp);
+    Slab* slab = slabs[exp];
+    int64_t offset = static_cast<char*>(p) - slab->blocks;
+    try {
+      new (p) T(std::move(*obj));
+    } catch (...) {
+      deallocate_slot(exp, p);
+      throw;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mux_slabs);
+      relocate_raw_pointers(slabs, layouts, obj, sizeof(T), slab->m_id, slab->s_id, offset);
+    }
+    return fancy_pointer<T>(slab->m_id, slab->s_id, offset);
+  }
+
+  // Like [export_slabs], but only describe the blocks that were written to
+  // since the last export, along with the updated slab metadata. Applying
+  // the delta to a SlabReplica of the last export brings it up to date.
+  SlabImage export_delta() {
+    std::lock_guard<std::mutex> lock(mux_slabs);
+    SlabImage image = make_slab_image(slabs, [](Slab* slab, int n) {
+      return slab->is_dirty(n);
+    }, SLAB_IMAGE_DELTA);
+    clear_dirty();
+    return image;
+  }
+
+  // Like [export_slabs], but leave out the blocks that are empty. After a
+  // resize, up to half of a slab is empty, so this can save a lot of bytes.
+  // A SlabReplica recreates the metadata of the blocks that were left out.
+  SlabImage export_sparse() {
+    std::lock_guard<std::mutex> lock(mux_slabs);
+    SlabImage image = make_slab_image(slabs, [](Slab* slab, int n) {
+      return n == 0 || !slab->is_block_empty(n);
+    }, 0);
+    clear_dirty();
+    return image;
+  }
+
+  // Get the root table of this allocator's slabs, creating it the first
+  // time it is needed
+  SlabRootTable* get_roots() {
+    Slab* slab = get_slab(SLAB_ROOTS_EXP);
+    if (slab->slab_md()->roots == 0) {
+      void *p = allocate_slot(SLAB_ROOTS_EXP);
+      memset(p, 0, sizeof(SlabRootTable));
+      // [allocate_slot] may have resized the slab, so find it again
+      slab = slabs[SLAB_ROOTS_EXP];
+      slab->slab_md()->roots = static_cast<char*>(p) - slab->blocks;
+      slab->mark_dirty_block(0);
+    }
+    return reinterpret_cast<SlabRootTable*>(slab->blocks + slab->slab_md()->roots);
+  }
+
+  // Make [p] the root with key [key] and name [name]
+  template <typename T>
+  void set_root(uint64_t key, const char *name, fancy_pointer<T> p) {
+    if (segment) {
+      throw std::runtime_error("Slabs in a slab segment cannot have roots");
+    }
+
+    SlabRootTable *roots = get_roots();
+    SlabRootEntry *entry = roots->find_or_insert(key, name);
+    entry->m_id = p.m_id;
+    entry->s_id = p.s_id;
+    entry->offset = p.offset;
+    slabs[SLAB_ROOTS_EXP]->mark_dirty(entry);
+  }
+
+  // Make [p] the root named [name], so that a receiver of the slabs can
+  // find it with [find_slab_root]
+  template <typename T>
+  void set_root(const char *name, fancy_pointer<T> p) {
+    set_root(slab_root_key(name), name, p);
+  }
+
+  // Make [p] the root with the id [id] (which must not be 0)
+  template <typename T>
+  void set_root(uint64_t id, fancy_pointer<T> p) {
+    set_root(id, "", p);
+  }
+
+  // Freeze a consistent image of every slab, and write it to [fd] from a
+  // child process (see SlabSnapshot), while this process keeps allocating
+  // and writing to the slabs. The only pause is the fork itself. Like
+  // [export_slabs], this starts a new delta.
+  // Note: only slabs on the heap can be snapshotted, since writes to shared
+  // mappings (files, memfds and segments) are seen by the child
+  SlabSnapshot snapshot(int fd) {
+    std::lock_guard<std::mutex> lock(mux_slabs);
+    for (Slab* slab : slabs) {
+      if (slab != nullptr && (slab->fd >= 0 || !slab->owns_blocks)) {
+        throw std::runtime_error("Only slabs on the heap can be snapshotted");
+      }
+    }
+
+    SlabImage image = make_slab_image(slabs);
+    SlabSnapshot snap = fork_slab_image(image, fd);
+    clear_dirty();
+    return snap;
+  }
+
+  // Stream the blocks of the slabs to [sink] as they fill up, holding back
+  // [lag] complete blocks of each slab (see SlabStream). Passing each image
+  // to SlabReplica::apply on the receiver rebuilds the slabs.
+  // Note: streaming is not supported for slabs in a SlabSegment
+  void stream_to(SlabStream::Sink sink, size_t lag = 1) {
+    std::lock_guard<std::mutex> lock(mux_slabs);
+    if (segment) {
+      throw std::runtime_error("Slabs in a slab segment cannot be streamed");
+    }
+    stream.reset(new SlabStream(std::move(sink), lag));
+  }
+
+  // Send every block that was written to since it was streamed, e.g. once
+  // the container is complete
+  void flush_stream() {
+    std::lock_guard<std::mutex> lock(mux_slabs);
+    if (stream) {
+      stream->flush(slabs);
+    }
+  }
+
+  // Send the slabs to another process on this host over the Unix domain
+  // socket [sock]. Only the file descriptors of the slabs are sent, so the
+  // other process maps the slabs instead of receiving a copy of them (see
+  // SharedSlabs).
+  // Note: only allocators created with [memfd_backed] can share their slabs
+  void share_slabs(int sock) {
+    std::lock_guard<std::mutex> lock(mux_slabs);
+    if (!memfd) {
+      throw std::runtime_error("Only memfd backed slabs can be shared");
+    }
+
+    SlabImage image = make_slab_image(slabs);
+    std::vector<int> fds;
+    for (Slab* slab : slabs) {
+      if (slab != nullptr) {
+        fds.push_back(slab->fd);
+      }
+    }
+    send_slab_fds(sock, image, fds);
+  }
+
+  // Record that the object at [p], which is in one of the slabs, was
+  // written to in place
+  void mark_dirty(void* p) {
+    for (Slab* slab : slabs) {
+      if (slab != nullptr && slab->blocks <= static_cast<char*>(p) &&
+          static_cast<char*>(p) < slab->blocks + slab->size()) {
+        slab->mark_dirty(p);
+        return;
+      }
+    }
+  }
+
+  void clear_dirty() {
+    for (Slab* slab : slabs) {
+      if (slab != nullptr) {
+        slab->clear_dirty();
+      }
+    }
+  }
+
   ~SlabAllocatorInternal() {
+    if (detach_segment != nullptr) {
+      detach_segment(*segment);
+    }
     for (Slab* slab : slabs) {
       delete slab;
     }
+    release_slab_ids(id_m_id, id_base);
   }
 };
 
-template <typename T>
+// An allocator whose pointers are [Ptr<T>]: fancy_pointer by default, or
+// one of the other pointer types (see packed_fancy_pointer.h,
+// compressed_pointer.h, relative_pointer.h, pinned_fancy_pointer.h and
+// cached_fancy_pointer.h)
+template <typename T, template <typename> class Ptr = fancy_pointer>
 struct SlabAllocator {
   using value_type = T;
-  using pointer    = fancy_pointer<T>;
+  using pointer    = Ptr<T>;
   using internals  = SlabAllocatorInternal;
 
   // Shared pointer for allocator internals so copy allocators is easy,
@@ -36,7 +520,33 @@ struct SlabAllocator {
 
   // Default Constructor
   SlabAllocator() : internal(new internals())
-  {}
+  {
+    check_pinned_ids();
+  }
+
+  // Create an allocator whose slabs are files in the directory [dir]
+  // (see SlabAllocatorInternal)
+  explicit SlabAllocator(const std::string& dir) : internal(new internals(dir))
+  {
+    check_pinned_ids();
+  }
+
+  // Create an allocator whose slabs can be shared with other processes on
+  // this host (see SlabAllocatorInternal)
+  explicit SlabAllocator(memfd_backed_t tag) : internal(new internals(tag))
+  {
+    check_pinned_ids();
+  }
+
+  // Create an allocator that allocates from the slab segment in the shared
+  // memory file [fd], along with allocators in other processes (see
+  // SlabAllocatorInternal)
+  SlabAllocator(shared_segment_t tag, int fd, int m_id = -1,
+                size_t region_sz = SLAB_SEGMENT_REGION_SZ)
+    : internal(new internals(tag, fd, m_id, region_sz))
+  {
+    check_pinned_ids();
+  }
 
   // Default Destructor
   ~SlabAllocator() = default;
@@ -48,14 +558,29 @@ struct SlabAllocator {
 
   // Template Copy Constructor
   template <typename U>
-  constexpr SlabAllocator(const SlabAllocator<U>& rhs) noexcept
+  constexpr SlabAllocator(const SlabAllocator<U, Ptr>& rhs) noexcept
     : internal(rhs.internal)
   {}
 
+  // Pinned pointers with size class slab IDs can only point into slabs
+  // that have those IDs, so fail here instead of on every allocate
+  void check_pinned_ids() const
+  {
+    if (pins_size_class_s_id<pointer>::value && !internal->has_size_class_ids()) {
+      throw std::runtime_error("Pinned fancy pointers with size class slab ids need the "
+                               "first allocator of the process");
+    }
+  }
+
+  // [Ptr] is a template, so allocator_traits can't rebind this on its own
+  template <typename U>
+  struct rebind {
+    using other = SlabAllocator<U, Ptr>;
+  };
+
   [[nodiscard]]
   pointer allocate(size_t n)
   {
-    printf("---------%s---------\n", __PRETTY_FUNCTION__);
     // The index into the array of slabs. The slab at this index is the
     // slab that best fits the objects being allocated.
     size_t exp = log2_int_ceil(n * sizeof(value_type));
@@ -64,24 +589,26 @@ struct SlabAllocator {
       throw std::runtime_error("Tried to allocate an object that was too large");
     }
 
-    // Create a new Slab the first time this particular slab is needed.
-    // Uses double-checked locking paradigm
-    // TODO: Replace lock with atomic bool
-    if (internal->slabs[exp] == nullptr) {
-      std::lock_guard<std::mutex> lock(internal->mux_slabs);
-      if (internal->slabs[exp] == nullptr) {
-        internal->slabs[exp] = new Slab(pow2(exp));
-      }
-    }
+    // Find the correct slab for this size and use it do allocation. The
+    // slab is created the first time it is needed.
+    void *p = internal->allocate_slot(exp);
 
-    // Find the correct slab for this size and use it do allocation
-    Slab* slab = internal->slabs[exp];
-    auto [p, unused1, unused2] = slab->allocate();
+    // Create a fancy pointer from the pointer allocated from the slab. Some
+    // pointers can't point at every slot (e.g. pinned ones), so the slot
+    // is given back if there is none.
+    try {
+      return pointer::pointer_to(*static_cast<value_type*>(p));
+    } catch (...) {
+      internal->deallocate_slot(exp, p);
+      throw;
+    }
+  }
 
-    // Create a fancy pointer from the pointer allocated from the slab
-    auto ret = pointer::pointer_to(*static_cast<value_type*>(p));
-    std::cout << "-------- Returning " << ret << " -----------" << std::endl;
-    return ret;
+  // Record that the object at [p] was written to in place, so that it is
+  // part of the next delta export
+  void mark_dirty(pointer p)
+  {
+    internal->mark_dirty(static_cast<void*>(pointer::to_address(p)));
   }
 
   void deallocate(pointer p, size_t n) noexcept
@@ -99,9 +626,28 @@ struct SlabAllocator {
       // have been allocated because it was too large");
     } else {
       // Find the correct slab for this size and use it do allocation
-      Slab* slab = internal->slabs[exp];
-      void *void_p = (static_cast<void*>(fancy_pointer<T>::to_address(p)));
-      slab->deallocate(void_p);
+      void *void_p = (static_cast<void*>(pointer::to_address(p)));
+      internal->deallocate_slot(exp, void_p);
     }
   }
 };
+
+// Create an allocator for compressed pointers (see compressed_pointer.h),
+// whose slabs are in a new private slab segment of machine [m_id]. The
+// segment becomes the region of the tag of [Ptr] until the allocator (and
+// every copy of it) is destroyed, so there can only be one such allocator
+// per tag at a time.
+template <typename T, template <typename> class Ptr>
+SlabAllocator<T, Ptr> make_compressed_allocator(int m_id,
+                                                size_t region_sz = SLAB_SEGMENT_REGION_SZ) {
+  int fd = memfd_create("compressed_slabs", MFD_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("Could not create the file of a slab segment");
+  }
+
+  SlabAllocator<T, Ptr> alloc(shared_segment, fd, m_id, region_sz);
+  using region = compressed_region<typename Ptr<T>::tag>;
+  region::attach(*alloc.internal->segment);
+  alloc.internal->detach_segment = &region::detach;
+  return alloc;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "slab.h"
+#include "slab_lookup_table.h"
+
+#include <atomic>
+#include <cstdint>
+
+// A per-thread cache of the blocks of the slabs in the slab lookup table.
+// Following a fancy pointer through the table loads the Slab, and then its
+// blocks, from memory that every thread shares. The cache holds the address
+// of the blocks of recently used slabs along with the generation of their
+// entry in the table (see SlabTableEntry), so a hit only loads the
+// generation, and a slab that was resized (or replaced) since is a miss
+// rather than a stale address.
+
+// Number of entries in the cache of each thread, which is direct mapped
+constexpr int SLAB_CACHE_SZ = 64;
+
+struct SlabCacheEntry {
+  // slab_index_code of the slab, or 0 if the entry is empty
+  uint32_t key;
+
+  // Generation of the slab when [blocks] was read
+  uint32_t gen;
+
+  // Blocks of the slab, or null if no slab was registered
+  char *blocks;
+};
+
+thread_local SlabCacheEntry slab_cache[SLAB_CACHE_SZ];
+
+// Blocks of slab [s] of machine [m], or null if there is no such slab
+inline char *cached_slab_blocks(int m, int s) {
+  uint32_t key = slab_index_code(m, s);
+  uint32_t gen = slab_lookup_table[m].generation(s);
+
+  SlabCacheEntry& entry = slab_cache[key % SLAB_CACHE_SZ];
+  if (entry.key != key || entry.gen != gen) {
+    Slab *slab = reinterpret_cast<Slab*>(slab_lookup_table[m][s]);
+    entry = SlabCacheEntry{key, gen, (slab == nullptr) ? nullptr : slab->blocks};
+  }
+  return entry.blocks;
+}
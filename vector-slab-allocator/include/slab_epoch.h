@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Epoch based reclamation of memory that readers may still be using, such
+// as the slabs of a machine that was evicted from the slab lookup table.
+// Following a fancy pointer never takes a lock, so a reader can load an
+// entry of the table just before the entry is removed, and then go on
+// reading the slab. Memory that is no longer reachable from the table is
+// retired with the epoch in which it was unpublished, and released once
+// every reader that was around in that epoch is gone.
+// Note: threads that follow fancy pointers into slabs that may be evicted
+//       hold a SlabReadGuard while they do. Dereferencing itself doesn't
+//       check for one, so that it costs nothing when there is no eviction.
+
+// The current epoch. Retiring memory moves it on.
+std::atomic<uint64_t> slab_epoch{1};
+
+// A thread that reads slabs
+struct SlabReader {
+  // Epoch at which the outermost SlabReadGuard of the thread was created,
+  // or 0 if the thread holds none
+  std::atomic<uint64_t> epoch{0};
+
+  // Number of SlabReadGuards of the thread
+  int depth = 0;
+};
+
+// Memory to release once the readers of epoch [epoch] are gone
+struct SlabRetired {
+  uint64_t epoch;
+  std::function<void()> release;
+};
+
+// Held while changing [slab_readers] or [slab_retired]
+std::mutex slab_epoch_mux;
+
+std::vector<SlabReader*> slab_readers;
+std::vector<SlabRetired> slab_retired;
+
+// Registers the SlabReader of a thread the first time it reads, and
+// unregisters it when the thread exits
+struct SlabReaderHandle {
+  SlabReader reader;
+
+  SlabReaderHandle() {
+    std::lock_guard<std::mutex> lock(slab_epoch_mux);
+    slab_readers.push_back(&reader);
+  }
+
+  ~SlabReaderHandle() {
+    std::lock_guard<std::mutex> lock(slab_epoch_mux);
+    slab_readers.erase(std::find(slab_readers.begin(), slab_readers.end(), &reader));
+  }
+};
+
+SlabReader& this_slab_reader() {
+  thread_local SlabReaderHandle handle;
+  return handle.reader;
+}
+
+// While a SlabReadGuard exists, memory that its thread could have reached
+// through the slab lookup table is not released. Guards nest.
+struct SlabReadGuard {
+  SlabReader& reader;
+
+  SlabReadGuard() : reader(this_slab_reader()) {
+    if (reader.depth++ == 0) {
+      reader.epoch.store(slab_epoch.load());
+      // The store has to be visible before the table is read, or else a
+      // thread that retires memory could miss it
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+
+  ~SlabReadGuard() {
+    if (--reader.depth == 0) {
+      reader.epoch.store(0, std::memory_order_release);
+    }
+  }
+
+  SlabReadGuard(const SlabReadGuard&) = delete;
+  SlabReadGuard& operator=(const SlabReadGuard&) = delete;
+};
+
+// Oldest epoch that a reader is in, or the current epoch if there is no
+// reader
+// Note: [slab_epoch_mux] must be held
+uint64_t oldest_slab_reader_epoch() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  uint64_t oldest = slab_epoch.load();
+  for (SlabReader *reader : slab_readers) {
+    uint64_t epoch = reader->epoch.load();
+    if (epoch != 0) {
+      oldest = std::min(oldest, epoch);
+    }
+  }
+  return oldest;
+}
+
+// Release the retired memory that no reader can still be using
+void reclaim_slab_memory() {
+  std::vector<SlabRetired> ready;
+  {
+    std::lock_guard<std::mutex> lock(slab_epoch_mux);
+    uint64_t oldest = oldest_slab_reader_epoch();
+    auto it = std::partition(slab_retired.begin(), slab_retired.end(),
+                             [oldest](const SlabRetired& r) { return r.epoch >= oldest; });
+    std::move(it, slab_retired.end(), std::back_inserter(ready));
+    slab_retired.erase(it, slab_retired.end());
+  }
+
+  // Outside of the lock, since releasing may retire more memory
+  for (SlabRetired& r : ready) {
+    r.release();
+  }
+}
+
+// Call [release] once no reader can still be using memory that was just
+// unpublished from the slab lookup table. This may be right away.
+void retire_slab_memory(std::function<void()> release) {
+  {
+    std::lock_guard<std::mutex> lock(slab_epoch_mux);
+    slab_retired.push_back(SlabRetired{slab_epoch.fetch_add(1), std::move(release)});
+  }
+  reclaim_slab_memory();
+}
+
+// Wait until all memory retired so far is released
+// Note: waits for the SlabReadGuards of other threads, so the calling
+//       thread must not hold one
+void synchronize_slab_readers() {
+  assert(this_slab_reader().depth == 0 && "Waiting for readers inside of a SlabReadGuard");
+
+  uint64_t target = slab_epoch.fetch_add(1) + 1;
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(slab_epoch_mux);
+      if (oldest_slab_reader_epoch() >= target) {
+        break;
+      }
+    }
+    std::this_thread::yield();
+  }
+  reclaim_slab_memory();
+}
@@ -0,0 +1,440 @@
+#pragma once
+
+#include "slab.h"
+#include "slab_epoch.h"
+#include "slab_lookup_table.h"
+
+// iovec
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Magic number at the start of every slab image ("SLAB")
+constexpr uint32_t SLAB_IMAGE_MAGIC = 0x534c4142;
+
+// The header of an image is padded to a multiple of this, so that the blocks
+// that follow it are cache line aligned in a contiguous receive buffer
+constexpr size_t SLAB_IMAGE_ALIGN = 64;
+
+// Flag for images where blocks that are left out did not change since the
+// previous image. In other images, blocks that are left out are empty.
+constexpr uint32_t SLAB_IMAGE_DELTA = 1;
+
+// A slab image is laid out on the wire as:
+//   SlabImageHeader
+//   SlabImageEntry[num_slabs]
+//   SlabImageRun[num_runs]
+//   padding up to a multiple of SLAB_IMAGE_ALIGN bytes
+//   the blocks of each run, in the same order as the runs
+// The runs of each slab follow each other, in the same order as the entries.
+// A full image has a single run per slab covering all of its blocks. A
+// sparse image leaves out the blocks that are empty, and a delta image
+// (SLAB_IMAGE_DELTA) leaves out the blocks that did not change.
+// Fancy pointers inside the blocks are (m_id, s_id, offset) triples, so the
+// blocks are shipped verbatim without any pointer rewriting.
+struct SlabImageHeader {
+  uint32_t magic;
+
+  // Machine id of the sender
+  int m_id;
+
+  // Number of SlabImageEntry's that follow the header
+  int num_slabs;
+
+  // Number of SlabImageRun's that follow the entries
+  int num_runs;
+
+  // Combination of the SLAB_IMAGE_* flags
+  uint32_t flags;
+
+  uint32_t reserved;
+};
+
+struct SlabImageEntry {
+  // Slab id of the slab on the sender (its column in the slab lookup table)
+  int s_id;
+
+  // Size of each slot in the slab
+  int sz;
+
+  // Number of blocks in the slab, i.e. the slab is [num_blocks * 64*sz] bytes
+  int num_blocks;
+
+  // Number of runs of blocks of this slab that are in the image
+  int num_runs;
+
+  // The free_block_list of the slab's SlabMD, which may have changed even
+  // if the first block is not in the image
+  uint64_t free_block_list;
+};
+
+// A run of consecutive blocks of a slab
+struct SlabImageRun {
+  int first_block;
+  int num_blocks;
+};
+
+// A scatter-gather description of a slab image. [iov] can be passed straight
+// to writev/sendmsg; it points into [header] and into the slabs themselves,
+// so nothing is copied except the (small) header.
+// Note: the slabs must not be resized or freed while [iov] is in use
+// Note: [iov] can be longer than IOV_MAX, in which case it has to be sent
+// with several calls
+struct SlabImage {
+  // Storage for the SlabImageHeader, SlabImageEntry's, SlabImageRun's and
+  // padding
+  std::vector<char> header;
+
+  // [header] followed by the blocks of every run
+  std::vector<iovec> iov;
+
+  SlabImageHeader* image_header() {
+    return reinterpret_cast<SlabImageHeader*>(header.data());
+  }
+
+  SlabImageEntry* entries() {
+    return reinterpret_cast<SlabImageEntry*>(header.data() + sizeof(SlabImageHeader));
+  }
+
+  SlabImageRun* runs() {
+    return reinterpret_cast<SlabImageRun*>
+      (entries() + image_header()->num_slabs);
+  }
+
+  // Total number of bytes described by [iov]
+  size_t size() const {
+    size_t total = 0;
+    for (const iovec& v : iov) {
+      total += v.iov_len;
+    }
+    return total;
+  }
+};
+
+// Size of the header of an image with [num_slabs] slabs and [num_runs] runs,
+// including padding
+constexpr size_t slab_image_header_size(size_t num_slabs, size_t num_runs) {
+  size_t sz = sizeof(SlabImageHeader) + num_slabs * sizeof(SlabImageEntry) +
+    num_runs * sizeof(SlabImageRun);
+  return (sz + SLAB_IMAGE_ALIGN - 1) / SLAB_IMAGE_ALIGN * SLAB_IMAGE_ALIGN;
+}
+
+// Build the scatter-gather image of the blocks of [slabs] (null entries are
+// skipped) for which [include_block(slab, n)] is true. Slabs without any such
+// block are left out.
+template <typename SlabArray, typename Pred>
+SlabImage make_slab_image(const SlabArray& slabs, Pred include_block,
+                          uint32_t flags) {
+  std::vector<Slab*> image_slabs;
+  std::vector<SlabImageRun> runs;
+  std::vector<int> num_runs;
+
+  for (Slab* slab : slabs) {
+    if (slab == nullptr) {
+      continue;
+    }
+
+    // Merge consecutive blocks into runs, to keep the number of iovecs down
+    size_t first_run = runs.size();
+    for (int n = 0; n < slab->slab_md()->num_blocks; ++n) {
+      if (!include_block(slab, n)) {
+        continue;
+      }
+      if (runs.size() > first_run &&
+          runs.back().first_block + runs.back().num_blocks == n) {
+        ++runs.back().num_blocks;
+      } else {
+        runs.push_back({n, 1});
+      }
+    }
+
+    if (runs.size() > first_run) {
+      image_slabs.push_back(slab);
+      num_runs.push_back(runs.size() - first_run);
+    }
+  }
+
+  SlabImage image;
+  image.header.resize(slab_image_header_size(image_slabs.size(), runs.size()), 0);
+  *image.image_header() = SlabImageHeader{SLAB_IMAGE_MAGIC, M_ID,
+                                          int(image_slabs.size()), int(runs.size()),
+                                          flags, 0};
+  image.iov.push_back({image.header.data(), image.header.size()});
+
+  size_t run = 0;
+  for (size_t i = 0; i < image_slabs.size(); ++i) {
+    Slab* slab = image_slabs[i];
+    SlabMD* md = slab->slab_md();
+    image.entries()[i] = SlabImageEntry{slab->s_id, md->sz, md->num_blocks,
+                                        num_runs[i], md->free_block_list};
+
+    for (int r = 0; r < num_runs[i]; ++r, ++run) {
+      image.runs()[run] = runs[run];
+      image.iov.push_back({slab->blocks + size_t(runs[run].first_block) * 64*md->sz,
+                           size_t(runs[run].num_blocks) * 64*md->sz});
+    }
+  }
+
+  return image;
+}
+
+// Build the scatter-gather image of all the blocks of [slabs]
+template <typename SlabArray>
+SlabImage make_slab_image(const SlabArray& slabs) {
+  return make_slab_image(slabs, [](Slab*, int) { return true; }, 0);
+}
+
+// A checked view of a slab image in a receive buffer
+struct SlabImageView {
+  SlabImageHeader header;
+  std::vector<SlabImageEntry> entries;
+  std::vector<SlabImageRun> runs;
+
+  // Offset in the buffer of the blocks of each run
+  std::vector<size_t> run_offsets;
+
+  // Parse and check the slab image in [buf], which is [len] bytes long.
+  // If [with_blocks] is false, [buf] only holds the header of the image
+  // (e.g. because the blocks are shared through file descriptors).
+  SlabImageView(const char *buf, size_t len, bool with_blocks = true) {
+    if (len < sizeof(SlabImageHeader)) {
+      throw std::runtime_error("Slab image is too short");
+    }
+
+    memcpy(&header, buf, sizeof(header));
+
+    if (header.magic != SLAB_IMAGE_MAGIC) {
+      throw std::runtime_error("Buffer does not contain a slab image");
+    }
+    if (header.m_id < 0 || header.m_id >= MAX_MACHINES || header.m_id == M_ID) {
+      throw std::runtime_error("Slab image has an invalid machine id");
+    }
+    if (header.num_slabs < 0 || header.num_slabs > MAX_SLAB_IDS ||
+        header.num_runs < 0 ||
+        slab_image_header_size(header.num_slabs, header.num_runs) > len) {
+      throw std::runtime_error("Slab image has an invalid number of slabs");
+    }
+
+    entries.resize(header.num_slabs);
+    memcpy(entries.data(), buf + sizeof(SlabImageHeader),
+           header.num_slabs * sizeof(SlabImageEntry));
+    runs.resize(header.num_runs);
+    memcpy(runs.data(),
+           buf + sizeof(SlabImageHeader) + header.num_slabs * sizeof(SlabImageEntry),
+           header.num_runs * sizeof(SlabImageRun));
+
+    size_t offset = slab_image_header_size(header.num_slabs, header.num_runs);
+    size_t run = 0;
+    for (const SlabImageEntry& entry : entries) {
+      if (entry.s_id <= 0 || entry.s_id >= MAX_SLAB_IDS) {
+        throw std::runtime_error("Slab image has an invalid slab id");
+      }
+      if (entry.sz <= 0 || size_t(entry.sz) != round_pow2(entry.sz) ||
+          entry.num_blocks <= 0 || entry.num_runs < 0 ||
+          size_t(entry.num_runs) > runs.size() - run) {
+        throw std::runtime_error("Slab image has an invalid slab size");
+      }
+
+      // Runs must be in order, and must not overlap
+      int next_block = 0;
+      for (int r = 0; r < entry.num_runs; ++r, ++run) {
+        if (runs[run].first_block < next_block || runs[run].num_blocks <= 0 ||
+            runs[run].num_blocks > entry.num_blocks - runs[run].first_block) {
+          throw std::runtime_error("Slab image has an invalid run of blocks");
+        }
+        next_block = runs[run].first_block + runs[run].num_blocks;
+
+        size_t bytes = size_t(runs[run].num_blocks) * 64*entry.sz;
+        if (with_blocks && bytes > len - offset) {
+          throw std::runtime_error("Slab image is too short");
+        }
+        run_offsets.push_back(offset);
+        offset += bytes;
+      }
+    }
+
+    if (run != runs.size()) {
+      throw std::runtime_error("Slab image has an invalid run of blocks");
+    }
+  }
+};
+
+// Check that the metadata in the first block of [slab] agrees with [entry],
+// which was checked against the size of the image, so that the blocks of
+// [slab] can be walked without reading past the image
+void check_slab_md(Slab *slab, const SlabImageEntry& entry) {
+  if (slab->slab_md()->sz != entry.sz ||
+      slab->slab_md()->num_blocks != entry.num_blocks) {
+    throw std::runtime_error("Slab image has slab metadata that doesn't match its entry");
+  }
+}
+
+// Unregister [slabs] right away, and destroy them once no SlabReadGuard can
+// still be reading them (see slab_epoch.h)
+void retire_slabs(std::vector<std::unique_ptr<Slab>>& slabs) {
+  for (std::unique_ptr<Slab>& slab : slabs) {
+    if (slab != nullptr) {
+      slab->unregister();
+    }
+  }
+
+  auto retired = std::make_shared<std::vector<std::unique_ptr<Slab>>>(std::move(slabs));
+  slabs.clear();
+  retire_slab_memory([retired]() { retired->clear(); });
+}
+
+// The slabs of another machine, adopted from a received (full) slab image.
+// Each slab is registered in the slab lookup table under the sender's
+// machine id, so fancy pointers created by the sender resolve straight into
+// the receive buffer: nothing is copied and no pointers are fixed up.
+// Note: the receive buffer should be at least 8 byte aligned, and is only
+// written to if the slabs are swizzled (see slab_swizzle.h). It must
+// outlive the AdoptedSlabImage, and since other threads may still be
+// reading the slabs then, it should be released with retire_slab_memory
+// (or after synchronize_slab_readers).
+struct AdoptedSlabImage {
+  // Machine id of the sender
+  int m_id;
+
+  // The adopted slabs, which are unregistered when this is destroyed
+  std::vector<std::unique_ptr<Slab>> slabs;
+
+  AdoptedSlabImage(AdoptedSlabImage&&) = default;
+
+  ~AdoptedSlabImage() {
+    retire_slabs(slabs);
+  }
+
+  // Adopt the slab image in [buf], which is [len] bytes long
+  AdoptedSlabImage(char *buf, size_t len) {
+    SlabImageView view(buf, len);
+
+    m_id = view.header.m_id;
+
+    for (size_t i = 0; i < view.entries.size(); ++i) {
+      const SlabImageEntry& entry = view.entries[i];
+
+      if (slab_lookup_table[m_id][entry.s_id] != nullptr) {
+        throw std::runtime_error("Slab image has a duplicate slab id");
+      }
+
+      // The blocks of the slab have to be contiguous to be adopted in place
+      if (entry.num_runs != 1 || view.runs[i].num_blocks != entry.num_blocks) {
+        throw std::runtime_error("Only full slab images can be adopted");
+      }
+
+      slabs.emplace_back(new Slab(buf + view.run_offsets[i], m_id, entry.s_id));
+      check_slab_md(slabs.back().get(), entry);
+      slabs.back()->index();
+    }
+  }
+};
+
+// A copy of the slabs of another machine, which is kept up to date by
+// applying the full and delta images that it sends. Like an
+// AdoptedSlabImage, the slabs are registered under the sender's machine id.
+// Unlike an AdoptedSlabImage, the replica owns its blocks, since the blocks
+// of a delta have to be merged into the blocks that were received before.
+struct SlabReplica {
+  // Machine id of the sender, or -1 before the first image is applied
+  int m_id = -1;
+
+  // The replicated slabs, indexed by slab id
+  std::vector<std::unique_ptr<Slab>> slabs;
+
+  SlabReplica() = default;
+  SlabReplica(SlabReplica&&) = default;
+
+  ~SlabReplica() {
+    retire_slabs(slabs);
+  }
+
+  // Apply the full or delta slab image in [buf], which is [len] bytes long
+  void apply(const char *buf, size_t len) {
+    SlabImageView view(buf, len);
+
+    if (m_id != -1 && m_id != view.header.m_id) {
+      throw std::runtime_error("Slab image is from a different machine");
+    }
+    m_id = view.header.m_id;
+
+    size_t run = 0;
+    for (const SlabImageEntry& entry : view.entries) {
+      if (size_t(entry.s_id) >= slabs.size()) {
+        slabs.resize(entry.s_id + 1);
+      }
+      std::unique_ptr<Slab>& slab = slabs[entry.s_id];
+      size_t block_sz = 64*size_t(entry.sz);
+
+      // Blocks that the replica did not have before
+      int old_num_blocks = (slab == nullptr) ? 0 : slab->slab_md()->num_blocks;
+      size_t first_run = run;
+
+      if (slab == nullptr) {
+        // The first image of a slab has to include its metadata
+        if (entry.num_runs == 0 || view.runs[run].first_block != 0) {
+          throw std::runtime_error("Slab image is missing the first block of a slab");
+        }
+        if (slab_lookup_table[m_id][entry.s_id] != nullptr) {
+          throw std::runtime_error("Slab image has a duplicate slab id");
+        }
+
+        char *blocks;
+        if (posix_memalign((void**)&blocks, block_sz, entry.num_blocks * block_sz) != 0) {
+          throw std::bad_alloc();
+        }
+        slab.reset(new Slab(blocks, m_id, entry.s_id));
+        slab->owns_blocks = true;
+      } else if (slab->slab_md()->sz != entry.sz) {
+        throw std::runtime_error("Slab image changed the size of a slab");
+      } else if (slab->slab_md()->num_blocks < entry.num_blocks) {
+        // The slab was resized on the sender
+        char *blocks;
+        if (posix_memalign((void**)&blocks, block_sz, entry.num_blocks * block_sz) != 0) {
+          throw std::bad_alloc();
+        }
+        memcpy(blocks, slab->blocks, slab->size());
+
+        // Readers may still be following pointers into the old blocks
+        char *old_blocks = slab->blocks;
+        slab->blocks = blocks;
+        bump_slab_generation(m_id, entry.s_id);
+        retire_slab_memory([old_blocks]() { free(old_blocks); });
+      }
+
+      for (int r = 0; r < entry.num_runs; ++r, ++run) {
+        memcpy(slab->blocks + view.runs[run].first_block * block_sz,
+               buf + view.run_offsets[run],
+               view.runs[run].num_blocks * block_sz);
+      }
+
+      slab->slab_md()->num_blocks = entry.num_blocks;
+      slab->slab_md()->free_block_list = entry.free_block_list;
+      check_slab_md(slab.get(), entry);
+      slab->index();
+
+      // Blocks that were left out are empty, unless this is a delta and the
+      // replica already has them, so recreate their metadata. The first
+      // block holds the slab metadata, so it is never recreated.
+      int reset_from = (view.header.flags & SLAB_IMAGE_DELTA) ? old_num_blocks : 0;
+      reset_from = std::max(reset_from, 1);
+      size_t next_run = first_run;
+      for (int n = reset_from; n < entry.num_blocks; ++n) {
+        while (next_run < run &&
+               view.runs[next_run].first_block + view.runs[next_run].num_blocks <= n) {
+          ++next_run;
+        }
+        if (next_run < run && view.runs[next_run].first_block <= n) {
+          continue;
+        }
+        slab->nth_block(n)->initialize_tail(slab.get());
+      }
+    }
+  }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "slab_lookup_table.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// An index from addresses to the slabs that hold them, so that
+// fancy_pointer::pointer_to doesn't have to compare an address against
+// every slab in the slab lookup table.
+//
+// The address space is split into granules of 2^SLAB_INDEX_SHIFT bytes, and
+// a two level radix table (like a page table) holds an entry for each
+// granule:
+//   0                 - no slab overlaps the granule
+//   SLAB_INDEX_SHARED - several slabs may overlap it
+//   otherwise         - only slab [s] of machine [m] overlaps it, where the
+//                       entry is slab_index_code(m, s)
+// Every slab adds the range of addresses it may use (see Slab::index), so an
+// address whose granule has no entry is not in any slab. An entry is only a
+// candidate, which still has to be checked against the current size of the
+// slab, and shared granules fall back to scanning the lookup table.
+// Lookups don't take any locks. Adding and removing slabs, which only
+// happens when they are created, resized or destroyed, is serialized.
+
+// Granules are 64 KiB
+constexpr int SLAB_INDEX_SHIFT = 16;
+
+// Bits of the granule number that select the second level table
+constexpr int SLAB_INDEX_L2_BITS = 15;
+
+// Addresses at or above this are not indexed
+constexpr int SLAB_INDEX_ADDRESS_BITS = 47;
+
+constexpr int SLAB_INDEX_L1_BITS =
+  SLAB_INDEX_ADDRESS_BITS - SLAB_INDEX_SHIFT - SLAB_INDEX_L2_BITS;
+
+constexpr uint32_t SLAB_INDEX_SHARED = 0xffffffff;
+
+static_assert(MAX_MACHINES * MAX_SLAB_IDS < SLAB_INDEX_SHARED,
+              "Slab ids don't fit in the entries of the slab index");
+
+// Second level tables, which are created when a slab first uses their part
+// of the address space, and never freed
+std::atomic<std::atomic<uint32_t>*> slab_index[1 << SLAB_INDEX_L1_BITS];
+
+// Held while adding or removing a slab (see Slab::index)
+std::mutex slab_index_mux;
+
+// Set when a slab is above the indexed addresses, after which every lookup
+// falls back to scanning the lookup table
+std::atomic<bool> slab_index_overflow{false};
+
+constexpr uint32_t slab_index_code(int m, int s) {
+  return m * MAX_SLAB_IDS + s + 1;
+}
+
+// The entry of the granule of [addr], which may create its second level
+// table
+std::atomic<uint32_t>* slab_index_entry(uintptr_t addr) {
+  uintptr_t granule = addr >> SLAB_INDEX_SHIFT;
+  std::atomic<std::atomic<uint32_t>*>& l1 = slab_index[granule >> SLAB_INDEX_L2_BITS];
+
+  std::atomic<uint32_t> *l2 = l1.load(std::memory_order_acquire);
+  if (l2 == nullptr) {
+    std::atomic<uint32_t> *fresh = new std::atomic<uint32_t>[1 << SLAB_INDEX_L2_BITS]();
+    if (l1.compare_exchange_strong(l2, fresh, std::memory_order_acq_rel)) {
+      l2 = fresh;
+    } else {
+      delete[] fresh;
+    }
+  }
+  return &l2[granule & ((1 << SLAB_INDEX_L2_BITS) - 1)];
+}
+
+// Record that slab [s] of machine [m] may use the [len] bytes at [start].
+// The address one past them is included, since a fancy pointer can point
+// there too.
+// Note: [slab_index_mux] must be held
+void slab_index_add(int m, int s, const void *start, size_t len) {
+  uintptr_t first = uintptr_t(start);
+  if (len == 0) {
+    return;
+  }
+  if (first + len >= (1ULL << SLAB_INDEX_ADDRESS_BITS)) {
+    slab_index_overflow.store(true);
+    return;
+  }
+
+  uint32_t code = slab_index_code(m, s);
+  for (uintptr_t g = first >> SLAB_INDEX_SHIFT; g <= (first + len) >> SLAB_INDEX_SHIFT; ++g) {
+    std::atomic<uint32_t> *entry = slab_index_entry(g << SLAB_INDEX_SHIFT);
+    uint32_t old = entry->load(std::memory_order_relaxed);
+    if (old != code) {
+      entry->store((old == 0) ? code : SLAB_INDEX_SHARED, std::memory_order_relaxed);
+    }
+  }
+}
+
+// Undo [slab_index_add] for the same arguments. The entries of granules that
+// were shared with other slabs are set to [recount(g)], the entry that the
+// granule starting at [g] has without this slab.
+// Note: [slab_index_mux] must be held
+template <typename Recount>
+void slab_index_remove(int m, int s, const void *start, size_t len, Recount recount) {
+  uintptr_t first = uintptr_t(start);
+  if (len == 0 || first + len >= (1ULL << SLAB_INDEX_ADDRESS_BITS)) {
+    return;
+  }
+
+  uint32_t code = slab_index_code(m, s);
+  for (uintptr_t g = first >> SLAB_INDEX_SHIFT; g <= (first + len) >> SLAB_INDEX_SHIFT; ++g) {
+    std::atomic<uint32_t> *entry = slab_index_entry(g << SLAB_INDEX_SHIFT);
+    uint32_t old = entry->load(std::memory_order_relaxed);
+    if (old == code) {
+      entry->store(0, std::memory_order_relaxed);
+    } else if (old == SLAB_INDEX_SHARED) {
+      entry->store(recount(g << SLAB_INDEX_SHIFT), std::memory_order_relaxed);
+    }
+  }
+}
+
+// The entry of the granule of [addr], without creating anything
+uint32_t slab_index_lookup(const void *addr) {
+  uintptr_t a = uintptr_t(addr);
+  if (slab_index_overflow.load(std::memory_order_relaxed)) {
+    return SLAB_INDEX_SHARED;
+  }
+  if (a >= (1ULL << SLAB_INDEX_ADDRESS_BITS)) {
+    return 0;
+  }
+
+  uintptr_t granule = a >> SLAB_INDEX_SHIFT;
+  std::atomic<uint32_t> *l2 =
+    slab_index[granule >> SLAB_INDEX_L2_BITS].load(std::memory_order_acquire);
+  if (l2 == nullptr) {
+    return 0;
+  }
+  return l2[granule & ((1 << SLAB_INDEX_L2_BITS) - 1)].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "slab.h"
+#include "slab_roots.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+
+// Slabs don't know the types of the objects in them, so code that rewrites
+// or checks the fancy pointers stored in slabs (see slab_swizzle.h,
+// slab_validate.h and slab_relocate.h) is told where they are by the
+// caller, instead of guessing from the bytes. A SlabPointerLayout says where
+// the fancy pointers are in the objects of one type, which fill the slots of
+// one size: every allocated slot of that size is taken to hold one such
+// object, and slots of sizes that no layout describes to hold no fancy
+// pointers. The slot that holds the root table of a slab (see slab_roots.h)
+// is described by [slab_roots_layout], whatever the layouts say.
+// Note: only fancy pointers with the layout of fancy_pointer (m_id, s_id,
+// offset) are described, which includes cached_fancy_pointer
+
+// Size of a fancy pointer in a slab
+constexpr size_t SLAB_POINTER_SZ = 2*sizeof(int) + sizeof(int64_t);
+
+// Where the fancy pointers are in the objects in slots of [sz] bytes
+struct SlabPointerLayout {
+  size_t sz;
+
+  // Offsets of the fancy pointers from the start of an object
+  std::vector<size_t> offsets;
+};
+
+// The layout of objects of type [T], whose fancy pointers are at [offsets]
+// (e.g. offsetof(Node, next))
+template <typename T>
+SlabPointerLayout pointer_layout(std::initializer_list<size_t> offsets) {
+  for (size_t offset : offsets) {
+    if (offset + SLAB_POINTER_SZ > sizeof(T)) {
+      throw std::runtime_error("Fancy pointer is not inside of the object");
+    }
+  }
+  return SlabPointerLayout{round_pow2(sizeof(T)), offsets};
+}
+
+// The layout of the slot that holds a SlabRootTable
+const SlabPointerLayout& slab_roots_layout() {
+  static const SlabPointerLayout layout = []() {
+    SlabPointerLayout l{sizeof(SlabRootTable), {}};
+    for (int i = 0; i < SLAB_ROOTS_CAPACITY; ++i) {
+      l.offsets.push_back(offsetof(SlabRootTable, entries) + i*sizeof(SlabRootEntry) +
+                          offsetof(SlabRootEntry, m_id));
+    }
+    return l;
+  }();
+  return layout;
+}
+
+// The layout in [layouts] for slots of [sz] bytes, or null if there is none
+const SlabPointerLayout* find_pointer_layout(const std::vector<SlabPointerLayout>& layouts,
+                                             size_t sz) {
+  for (const SlabPointerLayout& layout : layouts) {
+    if (layout.sz == sz) {
+      return &layout;
+    }
+  }
+  return nullptr;
+}
+
+// Call [f(slot)] for every allocated slot of the [n]th block of [slab],
+// skipping the slots that hold metadata
+template <typename F>
+void for_each_allocated_slot(Slab *slab, int n, F f) {
+  size_t sz = slab->slab_md()->sz;
+  Block *blk = slab->nth_block(n);
+  size_t md_sz = (n == 0) ? sizeof(Metadata::all_md) : sizeof(BlockMD);
+  uint64_t allocated = ~blk->block_md()->free_slot_list &
+    BlockMD(slab, md_sz).free_slot_list;
+
+  while (allocated != 0) {
+    int i = ffsll(allocated) - 1;
+    allocated &= allocated - 1;
+    f(&blk->data[0] + i*sz);
+  }
+}
+
+// Call [f(slot)] for every allocated slot of [slab], skipping the slots
+// that hold metadata
+template <typename F>
+void for_each_allocated_slot(Slab *slab, F f) {
+  for (int n = 0; n < slab->slab_md()->num_blocks; ++n) {
+    for_each_allocated_slot(slab, n, f);
+  }
+}
+
+// Call [f(word)] for every fancy pointer that [layouts] place in the
+// allocated slots of blocks [first, last) of [slab]
+template <typename F>
+void for_each_pointer(Slab *slab, int first, int last,
+                      const std::vector<SlabPointerLayout>& layouts, F f) {
+  size_t sz = slab->slab_md()->sz;
+  const SlabPointerLayout *layout = find_pointer_layout(layouts, sz);
+  char *roots = (slab->slab_md()->roots != 0) ?
+    slab->blocks + slab->slab_md()->roots : nullptr;
+  if (layout == nullptr && roots == nullptr) {
+    return;
+  }
+
+  if (roots != nullptr && slab_roots_layout().sz != sz) {
+    throw std::runtime_error("Fancy pointer layout does not fit in its slots");
+  }
+  if (layout != nullptr) {
+    for (size_t offset : layout->offsets) {
+      if (offset + SLAB_POINTER_SZ > sz) {
+        throw std::runtime_error("Fancy pointer layout does not fit in its slots");
+      }
+    }
+  }
+
+  for (int n = first; n < last; ++n) {
+    for_each_allocated_slot(slab, n, [&](char *slot) {
+      const SlabPointerLayout *l = (slot == roots) ? &slab_roots_layout() : layout;
+      if (l != nullptr) {
+        for (size_t offset : l->offsets) {
+          f(slot + offset);
+        }
+      }
+    });
+  }
+}
+
+// Call [f(word)] for every fancy pointer that [layouts] place in the
+// allocated slots of [slab]
+template <typename F>
+void for_each_pointer(Slab *slab, const std::vector<SlabPointerLayout>& layouts, F f) {
+  for_each_pointer(slab, 0, slab->slab_md()->num_blocks, layouts, f);
+}
@@ -1,18 +1,437 @@
 #ifndef _SLAB_LOOKUP_TABLE_H
 #define _SLAB_LOOKUP_TABLE_H
 
-const int M_ID = 0; // Hard coded machine ID
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/mman.h>
+
+#include "slab_epoch.h"
+
+// Maximum number of machines that can have slabs in the lookup table, which
+// is as many as a packed_fancy_pointer can tell apart. Only the machines
+// that have slabs get a row (see SlabLookupTable).
+const int MAX_MACHINES = (1 << 12) - 2;
+
+// Maximum number of slabs per machine, enough for 1638 allocators (see
+// SLAB_ID_RANGES). Every row of the lookup table has room for this many
+// entries, but only the pages of the entries that were used take memory
+// (see SlabTableRow).
+const int MAX_SLAB_IDS = 1 << 16;
+
+// Number of slot sizes that slabs can have (1 to 2^39 bytes), which is the
+// most slabs that a single allocator has
+const int SLAB_SIZE_CLASSES = 40;
+
+// Number of ranges of slab IDs that allocators can reserve. Range [r] holds
+// the IDs [r * SLAB_SIZE_CLASSES + 1, (r + 1) * SLAB_SIZE_CLASSES], one for
+// each slot size (see reserve_slab_ids).
+const int SLAB_ID_RANGES = (MAX_SLAB_IDS - 1) / SLAB_SIZE_CLASSES;
+
+// Machine ID of this process. Every process that exchanges slabs must have a
+// distinct machine ID, since fancy pointers record the machine that created
+// them. Use [set_machine_id] to change it, preferably before allocating
+// anything.
+int M_ID = 0;
+
+// An entry of the slab lookup table
+struct SlabTableEntry {
+  // The Slab registered in this entry, or null
+  char *slab;
+
+  // Generation of the entry, which changes whenever [slab] changes or the
+  // blocks of the slab move, so that copies of the address of the blocks
+  // can tell that they are stale (see slab_cache.h). Generations are not
+  // reused for other entries, so this holds even if the row of the entry
+  // is evicted and created again.
+  std::atomic<uint32_t> generation;
+};
+
+// The entries of one machine, indexed by slab ID. A row has an entry for
+// every slab ID, so that a lookup is a single load once the row is found,
+// and entries never move, so readers never lock. Rows are mapped instead of
+// allocated: the kernel only backs the pages of the entries that were
+// written to, which start out zero (null), so a row whose machine has a
+// handful of slabs takes a page or two.
+// Readers use plain loads, so that the compiler can keep the blocks of a
+// slab in a register across a loop. Writers publish with release stores,
+// and every load of a reader depends on the one before it.
+struct SlabTableRow {
+  // First, so that the address of an entry is the row plus a multiple of
+  // the slab ID
+  SlabTableEntry entries[MAX_SLAB_IDS];
+
+  // One more than the highest slab ID that was registered in the row, so
+  // that scans don't look at the entries that were never used
+  int end = 0;
+
+  // Ranges of slab IDs that allocators reserved, guarded by [slab_table_mux]
+  std::vector<bool> reserved;
+
+  // Check if slab ID [s] is in a range that an allocator reserved
+  bool is_reserved(int s) const {
+    size_t r = (s - 1) / SLAB_SIZE_CLASSES;
+    return s > 0 && r < reserved.size() && reserved[r];
+  }
+
+  // Leaves [entries] alone, since the memory of a row is already zero
+  SlabTableRow() {}
+  SlabTableRow(const SlabTableRow&) = delete;
+  SlabTableRow& operator=(const SlabTableRow&) = delete;
+
+  static void* operator new(size_t sz) {
+    void *p = mmap(nullptr, sz, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    return p;
+  }
+
+  static void operator delete(void *p, size_t sz) {
+    munmap(p, sz);
+  }
+
+  // The slab registered as slab [s] of this machine, or null
+  char* operator[](int s) const {
+    if (unsigned(s) >= unsigned(MAX_SLAB_IDS)) {
+      return nullptr;
+    }
+    return entries[s].slab;
+  }
+
+  // Generation of slab [s] of this machine (see SlabTableEntry)
+  uint32_t generation(int s) const {
+    if (unsigned(s) >= unsigned(MAX_SLAB_IDS)) {
+      return 0;
+    }
+    return entries[s].generation.load(std::memory_order_acquire);
+  }
+
+  // Entry [s], without the checks of operator[], for pointers that can only
+  // hold the IDs of registered slabs
+  const SlabTableEntry& entry(int s) const {
+    return entries[s];
+  }
+
+  // Number of slab IDs that may have a slab registered
+  int size() const {
+    return __atomic_load_n(&end, __ATOMIC_ACQUIRE);
+  }
+
+  // True if nothing is registered or reserved in this row
+  bool empty() const {
+    return end == 0 && std::find(reserved.begin(), reserved.end(), true) == reserved.end();
+  }
+
+  // Move the entries and reserved ranges of [from] into this row, which is
+  // empty, and leave [from] empty
+  // Note: [slab_table_mux] must be held, and no other thread may be
+  //       following pointers into either row
+  void take(SlabTableRow& from) {
+    for (int s = 0; s < from.end; ++s) {
+      entries[s].slab = from.entries[s].slab;
+      entries[s].generation.store(from.entries[s].generation.load(std::memory_order_relaxed),
+                                  std::memory_order_relaxed);
+      from.entries[s].slab = nullptr;
+      from.entries[s].generation.store(0, std::memory_order_relaxed);
+    }
+    end = from.end;
+    from.end = 0;
+    reserved.swap(from.reserved);
+    from.reserved.clear();
+  }
+};
+
+// The row of every machine that has no slabs (or that was evicted), which
+// is always empty
+SlabTableRow slab_table_empty_row;
 
 // The slab lookup table is a 2D table, where the row numbers represent the
 // machine ID, and the columns represent the slab ID. Entries are pointers
-// to slabs.
+// to slabs, and [slab_lookup_table[m][s]] is null for slabs that are not
+// registered, including out of range ones.
 // Note: we use char* so that pointer arithmetic is easier
 // Note: [slab_lookup_table[M_ID][0]] is meant for all fancy pointers that
-//       don't belong to a slab. This is necessary because containers create
-//       fancy pointers sometimes that haven't been allocated from a
-//       Slab/SlabAllocator. TODO: We may have to look into this
-// TODO: Currently, the slab lookup table support allocation for ONLY ONE
-//       object. The slab lookup table should be resizable
-char* slab_lookup_table[1][40] = { {0} };
+//       don't belong to a slab, and is always null. This is necessary
+//       because containers create fancy pointers sometimes that haven't
+//       been allocated from a Slab/SlabAllocator. TODO: We may have to look
+//       into this
+// Note: rows other than [M_ID] hold slabs adopted from other machines
+// Note: every Slab has an entry of its own (see [register_slab]), so any
+//       number of allocators can have slabs of the same size
+// Note: the table only holds a pointer per machine, and rows are created
+//       when a machine registers its first slab, so a process can adopt
+//       slabs from thousands of machines. Rows of machines that left are
+//       dropped with [evict_machine].
+// Note: the row of [M_ID] is held in the table itself, so that pointers
+//       that are known to be local (see pinned_fancy_pointer.h) find their
+//       entries without loading the row from [rows]
+struct SlabLookupTable {
+  // The rows of all machines. The last one stands in for the machine IDs
+  // that are out of range (such as the -1 of null fancy pointers).
+  SlabTableRow *rows[MAX_MACHINES + 1];
+
+  // The row of [M_ID], which [rows] points to as well
+  SlabTableRow local_row;
+
+  SlabLookupTable() {
+    std::fill(rows, rows + MAX_MACHINES + 1, &slab_table_empty_row);
+    rows[M_ID] = &local_row;
+  }
+
+  const SlabTableRow& operator[](int m) const {
+    if (unsigned(m) >= unsigned(MAX_MACHINES)) {
+      m = MAX_MACHINES;
+    }
+    return *rows[m];
+  }
+
+  // Entry [s] of machine [m], without the checks of operator[] (see
+  // SlabTableRow::entry)
+  const SlabTableEntry& entry(int m, int s) const {
+    return rows[m]->entry(s);
+  }
+
+  // Entry [s] of this machine, without the checks of operator[]
+  const SlabTableEntry& local_entry(int s) const {
+    return local_row.entry(s);
+  }
+};
+
+SlabLookupTable slab_lookup_table;
+
+// Held while changing the slab lookup table. Readers don't take it.
+std::mutex slab_table_mux;
+
+// The last generation given to an entry of the slab lookup table, guarded
+// by [slab_table_mux]
+uint32_t slab_table_generation = 0;
+
+// Row of machine [m], which is created if the machine has none
+// Note: [slab_table_mux] must be held
+SlabTableRow& slab_table_row(int m) {
+  if (m < 0 || m >= MAX_MACHINES) {
+    throw std::runtime_error("Machine ID out of range");
+  }
+
+  if (slab_lookup_table.rows[m] == &slab_table_empty_row) {
+    __atomic_store_n(&slab_lookup_table.rows[m], new SlabTableRow(), __ATOMIC_RELEASE);
+  }
+  return *slab_lookup_table.rows[m];
+}
+
+// Entry [s] of machine [m], whose row is created if the machine has none
+// Note: [slab_table_mux] must be held
+SlabTableEntry& slab_table_entry(int m, int s) {
+  // Slab ID 0 stays empty, so that looking it up gives null
+  if (s <= 0 || s >= MAX_SLAB_IDS) {
+    throw std::runtime_error("Slab ID out of range");
+  }
+
+  SlabTableRow& row = slab_table_row(m);
+  if (s >= row.end) {
+    __atomic_store_n(&row.end, s + 1, __ATOMIC_RELEASE);
+  }
+  return row.entries[s];
+}
+
+// Give [entry] a generation that no entry had before
+// Note: [slab_table_mux] must be held
+void next_slab_generation(SlabTableEntry& entry) {
+  if (++slab_table_generation == 0) {
+    ++slab_table_generation;
+  }
+  entry.generation.store(slab_table_generation, std::memory_order_release);
+}
+
+// Put [slab] in [entry]
+// Note: [slab_table_mux] must be held
+void set_slab_entry(SlabTableEntry& entry, char *slab) {
+  __atomic_store_n(&entry.slab, slab, __ATOMIC_RELEASE);
+  next_slab_generation(entry);
+}
+
+// Register [slab] under a slab ID of machine [m] that is not in use, and not
+// reserved by an allocator, which is [preferred] if it is free. Returns the
+// slab ID.
+int register_slab(int m, char *slab, int preferred) {
+  std::lock_guard<std::mutex> lock(slab_table_mux);
+  const SlabTableRow& row = slab_table_row(m);
+
+  int s = preferred;
+  if (slab_lookup_table[m][s] != nullptr || row.is_reserved(s)) {
+    // Slab ID 0 is for pointers that are not into any slab
+    for (s = 1; slab_lookup_table[m][s] != nullptr || row.is_reserved(s); ++s) {}
+  }
+
+  set_slab_entry(slab_table_entry(m, s), slab);
+  return s;
+}
+
+// Register [slab] as slab [s] of machine [m], which must not be in use (e.g.
+// because it is in a range of IDs that the caller reserved). Returns [s].
+int register_slab_at(int m, int s, char *slab) {
+  std::lock_guard<std::mutex> lock(slab_table_mux);
+  if (slab_lookup_table[m][s] != nullptr) {
+    throw std::runtime_error("Slab ID is already in use");
+  }
+
+  set_slab_entry(slab_table_entry(m, s), slab);
+  return s;
+}
+
+// Reserve range [r] of slab IDs in [row], unless it is reserved already, or
+// slabs that were registered on their own are in the way. Returns true if
+// it was reserved.
+// Note: [slab_table_mux] must be held
+bool try_reserve_slab_ids(SlabTableRow& row, int r) {
+  if (size_t(r) < row.reserved.size() && row.reserved[r]) {
+    return false;
+  }
+
+  int base = r * SLAB_SIZE_CLASSES;
+  for (int s = base + 1; s <= base + SLAB_SIZE_CLASSES; ++s) {
+    if (row[s] != nullptr) {
+      return false;
+    }
+  }
+
+  if (size_t(r) >= row.reserved.size()) {
+    row.reserved.resize(r + 1, false);
+  }
+  row.reserved[r] = true;
+  return true;
+}
+
+// Reserve a range of slab IDs of machine [m] for an allocator, so that its
+// slabs never share IDs with the slabs of other allocators, and its slab
+// with [2^exp] byte slots is slab [base + exp + 1]. Returns [base]. The
+// first allocator of a machine gets base 0, so its slabs have the IDs that
+// they would ask for on their own.
+int reserve_slab_ids(int m) {
+  std::lock_guard<std::mutex> lock(slab_table_mux);
+  SlabTableRow& row = slab_table_row(m);
+
+  for (int r = 0; r < SLAB_ID_RANGES; ++r) {
+    if (try_reserve_slab_ids(row, r)) {
+      return r * SLAB_SIZE_CLASSES;
+    }
+  }
+
+  throw std::runtime_error("Out of slab IDs");
+}
+
+// Reserve the range of slab IDs of machine [m] that starts at [base], for
+// slabs that must have the IDs they had before (e.g. the fixed IDs of a
+// slab segment). Throws if the range is reserved or any of its IDs is in
+// use, instead of taking the slabs of someone else. Returns [base].
+int reserve_slab_ids_at(int m, int base) {
+  std::lock_guard<std::mutex> lock(slab_table_mux);
+  SlabTableRow& row = slab_table_row(m);
+
+  int r = base / SLAB_SIZE_CLASSES;
+  if (base < 0 || base % SLAB_SIZE_CLASSES != 0 || r >= SLAB_ID_RANGES) {
+    throw std::runtime_error("Slab ID out of range");
+  }
+  if (!try_reserve_slab_ids(row, r)) {
+    throw std::runtime_error("Slab IDs are already in use");
+  }
+  return base;
+}
+
+// Release the range of slab IDs of machine [m] that starts at [base]
+void release_slab_ids(int m, int base) {
+  std::lock_guard<std::mutex> lock(slab_table_mux);
+  if (m < 0 || m >= MAX_MACHINES) {
+    return;
+  }
+
+  SlabTableRow *row = slab_lookup_table.rows[m];
+  size_t r = base / SLAB_SIZE_CLASSES;
+  if (r < row->reserved.size()) {
+    row->reserved[r] = false;
+  }
+}
+
+// Unregister [slab] from slab [s] of machine [m], unless something else was
+// registered there since. Returns true if it was still registered.
+bool unregister_slab(int m, int s, char *slab) {
+  std::lock_guard<std::mutex> lock(slab_table_mux);
+  if (slab_lookup_table[m][s] != slab) {
+    return false;
+  }
+
+  set_slab_entry(slab_table_entry(m, s), nullptr);
+  return true;
+}
+
+// Record that the blocks of slab [s] of machine [m] moved
+void bump_slab_generation(int m, int s) {
+  std::lock_guard<std::mutex> lock(slab_table_mux);
+  if (slab_lookup_table[m][s] == nullptr) {
+    return;
+  }
+  next_slab_generation(slab_table_entry(m, s));
+}
+
+// Take the row of machine [m] out of the slab lookup table, so that none of
+// its slabs are found anymore. Returns the row, or null if [m] had none.
+// Readers may still be using the row, so it has to be retired (see
+// slab_epoch.h) rather than deleted.
+SlabTableRow* take_slab_row(int m) {
+  std::lock_guard<std::mutex> lock(slab_table_mux);
+  if (m < 0 || m >= MAX_MACHINES || slab_lookup_table.rows[m] == &slab_table_empty_row) {
+    return nullptr;
+  }
+  if (m == M_ID) {
+    throw std::runtime_error("The row of this machine can't be taken");
+  }
+
+  SlabTableRow *row = slab_lookup_table.rows[m];
+  __atomic_store_n(&slab_lookup_table.rows[m], &slab_table_empty_row, __ATOMIC_RELEASE);
+  return row;
+}
+
+// Set the machine ID of this process. The slabs that were registered under
+// the old machine ID stay there, and the row of the new one becomes the row
+// held in the table.
+// Note: no other thread may be following pointers while the ID changes
+void set_machine_id(int m_id) {
+  assert(0 <= m_id && m_id < MAX_MACHINES && "Machine ID out of range");
+
+  SlabTableRow *old_row = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(slab_table_mux);
+    if (m_id == M_ID) {
+      return;
+    }
+
+    SlabTableRow& local_row = slab_lookup_table.local_row;
+    SlabTableRow *row = &slab_table_empty_row;
+    if (!local_row.empty()) {
+      row = new SlabTableRow();
+      row->take(local_row);
+    }
+    __atomic_store_n(&slab_lookup_table.rows[M_ID], row, __ATOMIC_RELEASE);
+
+    if (slab_lookup_table.rows[m_id] != &slab_table_empty_row) {
+      old_row = slab_lookup_table.rows[m_id];
+      local_row.take(*old_row);
+    }
+    __atomic_store_n(&slab_lookup_table.rows[m_id], &local_row, __ATOMIC_RELEASE);
+    M_ID = m_id;
+  }
+
+  if (old_row != nullptr) {
+    retire_slab_memory([old_row]() { delete old_row; });
+  }
+}
 
 #endif
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "fancy_pointer.h"
+#include "slab.h"
+#include "slab_lookup_table.h"
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+
+// Helpers that hide the latency of chasing pointers through node based
+// containers on slab memory. Every hop through a fancy pointer loads its
+// entry of the slab lookup table and the blocks of its Slab before the node
+// itself, so these start loading the next nodes while the current one is
+// processed.
+
+// Number of nodes that a prefetching_iterator runs ahead by default
+constexpr int SLAB_PREFETCH_DISTANCE = 4;
+
+// Start loading the object that [p] points to
+template <typename T>
+inline void prefetch_pointer(T *p) {
+  __builtin_prefetch(p);
+}
+
+// Start loading the object that [p] points to. The slab lookup table entry
+// and the Slab are loaded right away, since the address depends on them,
+// but they are shared by every node of the slab and so are mostly cached.
+template <typename T>
+inline void prefetch_pointer(const fancy_pointer<T> &p) {
+  if (p.s_id <= 0) {
+    __builtin_prefetch((const void*) p.offset);
+    return;
+  }
+
+  Slab *slab = reinterpret_cast<Slab*>(slab_lookup_table[p.m_id][p.s_id]);
+  if (slab != nullptr) {
+    __builtin_prefetch(slab->blocks + p.offset);
+  }
+}
+
+// Start loading the object that [p] points to, for the other pointer types
+// (see fancy_pointer_base.h)
+template <typename P, typename = decltype(std::declval<const P&>().get())>
+inline void prefetch_pointer(const P &p) {
+  __builtin_prefetch(p.get());
+}
+
+// A forward iterator over [It] that keeps a second iterator [distance]
+// elements ahead, and prefetches the element under it. Advancing the second
+// iterator follows the links of the nodes ahead of the current one, so
+// their loads overlap with the work done on the current element.
+template <typename It>
+struct prefetching_iterator {
+  using iterator_category = std::forward_iterator_tag;
+  using value_type        = typename std::iterator_traits<It>::value_type;
+  using difference_type   = typename std::iterator_traits<It>::difference_type;
+  using pointer           = typename std::iterator_traits<It>::pointer;
+  using reference         = typename std::iterator_traits<It>::reference;
+
+  It cur;
+  It ahead;
+  It last;
+
+  prefetching_iterator(It first, It l, int distance = SLAB_PREFETCH_DISTANCE)
+    : cur(first), ahead(first), last(l)
+  {
+    for (int i = 0; i < distance && ahead != last; ++i) {
+      ++ahead;
+      if (ahead != last) {
+        __builtin_prefetch(std::addressof(*ahead));
+      }
+    }
+  }
+
+  reference operator*() const { return *cur; }
+  auto operator->() const { return std::addressof(*cur); }
+
+  prefetching_iterator& operator++() {
+    ++cur;
+    if (ahead != last) {
+      ++ahead;
+      if (ahead != last) {
+        __builtin_prefetch(std::addressof(*ahead));
+      }
+    }
+    return *this;
+  }
+
+  prefetching_iterator operator++(int) {
+    prefetching_iterator tmp(*this);
+    ++*this;
+    return tmp;
+  }
+
+  friend bool operator==(const prefetching_iterator& lhs, const prefetching_iterator& rhs) {
+    return lhs.cur == rhs.cur;
+  }
+  friend bool operator!=(const prefetching_iterator& lhs, const prefetching_iterator& rhs) {
+    return lhs.cur != rhs.cur;
+  }
+};
+
+// The elements of [c] (e.g. a std::list, std::map or std::forward_list on
+// a SlabAllocator), for range based for loops that prefetch [distance]
+// nodes ahead:
+//   for (auto& x : prefetched(lst)) { ... }
+template <typename It>
+struct prefetched_range {
+  prefetching_iterator<It> first;
+  prefetching_iterator<It> last;
+
+  prefetching_iterator<It> begin() const { return first; }
+  prefetching_iterator<It> end() const { return last; }
+};
+
+template <typename Container>
+auto prefetched(Container& c, int distance = SLAB_PREFETCH_DISTANCE) {
+  using It = decltype(c.begin());
+  return prefetched_range<It>{prefetching_iterator<It>(c.begin(), c.end(), distance),
+                              prefetching_iterator<It>(c.end(), c.end(), 0)};
+}
+
+// Call [f] on each node of the linked list that starts at [head], whose
+// nodes link to the next one with the member [next] (e.g. &Node::next). The
+// next node is prefetched before [f] is called on the current one.
+template <typename P, typename Node, typename F>
+void for_each_node(P head, P Node::*next, F f) {
+  for (P p = head; p != nullptr; ) {
+    P n = (*p).*next;
+    if (n != nullptr) {
+      prefetch_pointer(n);
+    }
+    f(*p);
+    p = n;
+  }
+}
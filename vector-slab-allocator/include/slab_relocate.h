@@ -0,0 +1,99 @@
+#pragma once
+
+#include "slab.h"
+#include "slab_layout.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// fancy_pointer::pointer_to falls back to the raw form (0, 0, address) for
+// objects that are not in any slab, e.g. the sentinel node inside of a
+// container whose header is on the stack. A raw fancy pointer is only valid
+// in the process that created it, so slabs that hold one can't be sent to
+// another machine. These find raw fancy pointers in slabs, and rewrite the
+// ones to an object that was moved into a slab. The fancy pointers are where
+// the SlabPointerLayouts passed in say (see slab_layout.h).
+// Note: swizzled slabs are full of raw fancy pointers, so unswizzle them
+// first
+
+// Raw fancy pointers to addresses outside of this range (e.g. the zeros of
+// unused root table entries) are not taken to point anywhere
+constexpr uint64_t RAW_POINTER_MIN = 4096;
+constexpr uint64_t RAW_POINTER_MAX = 1ULL << 47;
+
+// Where a raw fancy pointer is stored in a slab
+struct RawPointerRef {
+  // Slab id of the slab that holds the fancy pointer
+  int s_id;
+
+  // Offset of the fancy pointer in the slab
+  size_t offset;
+
+  // Address that the fancy pointer holds
+  uint64_t address;
+};
+
+// Read the raw fancy pointer at [word] into [addr]. Returns false if there
+// is no raw fancy pointer at [word].
+bool read_raw_pointer(const char *word, uint64_t& addr) {
+  int m, s;
+  memcpy(&m, word, sizeof(m));
+  memcpy(&s, word + sizeof(m), sizeof(s));
+  memcpy(&addr, word + 2*sizeof(int), sizeof(addr));
+  return m == 0 && s == 0 && RAW_POINTER_MIN <= addr && addr < RAW_POINTER_MAX;
+}
+
+// Find every raw fancy pointer that [layouts] place in [slabs] (null
+// entries are skipped)
+template <typename SlabArray>
+std::vector<RawPointerRef> find_raw_pointers(const SlabArray& slabs,
+                                             const std::vector<SlabPointerLayout>& layouts) {
+  std::vector<RawPointerRef> refs;
+  for (auto& slab : slabs) {
+    if (!slab) {
+      continue;
+    }
+    for_each_pointer(&*slab, layouts, [&](char *word) {
+      uint64_t addr;
+      if (read_raw_pointer(word, addr)) {
+        refs.push_back({slab->s_id, size_t(word - slab->blocks), addr});
+      }
+    });
+  }
+  return refs;
+}
+
+// Rewrite every raw fancy pointer that [layouts] place in [slabs] that
+// points into the [len] bytes at [old_addr] (or one past their end) to
+// point into the copy of them at offset [offset] of slab [s_id] of machine
+// [m_id]. Returns the number of fancy pointers rewritten, whose blocks are
+// marked dirty.
+template <typename SlabArray>
+size_t relocate_raw_pointers(const SlabArray& slabs,
+                             const std::vector<SlabPointerLayout>& layouts,
+                             const void *old_addr, size_t len,
+                             int m_id, int s_id, int64_t offset) {
+  uint64_t first = uint64_t(old_addr);
+  size_t count = 0;
+
+  for (auto& slab : slabs) {
+    if (!slab) {
+      continue;
+    }
+    for_each_pointer(&*slab, layouts, [&](char *word) {
+      uint64_t addr;
+      if (!read_raw_pointer(word, addr) || addr < first || addr > first + len) {
+        return;
+      }
+
+      int64_t new_offset = offset + int64_t(addr - first);
+      memcpy(word, &m_id, sizeof(m_id));
+      memcpy(word + sizeof(m_id), &s_id, sizeof(s_id));
+      memcpy(word + 2*sizeof(int), &new_offset, sizeof(new_offset));
+      slab->mark_dirty(word);
+      ++count;
+    });
+  }
+  return count;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "fancy_pointer.h"
+#include "slab.h"
+#include "slab_lookup_table.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// Maximum number of roots of a machine
+constexpr int SLAB_ROOTS_CAPACITY = 32;
+
+// Maximum length of the name of a root, including the terminating null
+constexpr size_t SLAB_ROOT_NAME_SZ = 40;
+
+// A named (or numbered) fancy pointer into the slabs of a machine
+struct SlabRootEntry {
+  // The id of the root, or the hash of its name (see [slab_root_key]).
+  // 0 for unused entries.
+  uint64_t key;
+
+  // The fancy pointer, as (m_id, s_id, offset)
+  int m_id;
+  int s_id;
+  int64_t offset;
+
+  // Name of the root, or empty if the root has an id
+  char name[SLAB_ROOT_NAME_SZ];
+};
+
+// The roots of a machine, which let a receiver find the containers in its
+// slabs without knowing their offsets. The table is an object in the slab
+// with [sizeof(SlabRootTable)] byte slots, and the SlabMD of that slab holds
+// its offset, so the table travels with the slabs in images, files and
+// shared memory, and is found in O(1) once they are adopted.
+// The table is an open addressing hash table, with linear probing.
+struct SlabRootTable {
+  SlabRootEntry entries[SLAB_ROOTS_CAPACITY];
+
+  // Find the entry for [key] and [name], or null if there is none
+  SlabRootEntry* find(uint64_t key, const char *name) {
+    for (int i = 0; i < SLAB_ROOTS_CAPACITY; ++i) {
+      SlabRootEntry& entry = entries[(key + i) % SLAB_ROOTS_CAPACITY];
+      if (entry.key == 0) {
+        return nullptr;
+      }
+      if (entry.key == key && strncmp(entry.name, name, SLAB_ROOT_NAME_SZ) == 0) {
+        return &entry;
+      }
+    }
+    return nullptr;
+  }
+
+  // Find the entry for [key] and [name], or claim an unused one for it
+  SlabRootEntry* find_or_insert(uint64_t key, const char *name) {
+    if (strlen(name) >= SLAB_ROOT_NAME_SZ) {
+      throw std::runtime_error("Name of a slab root is too long");
+    }
+
+    for (int i = 0; i < SLAB_ROOTS_CAPACITY; ++i) {
+      SlabRootEntry& entry = entries[(key + i) % SLAB_ROOTS_CAPACITY];
+      if (entry.key == 0) {
+        entry.key = key;
+        strncpy(entry.name, name, SLAB_ROOT_NAME_SZ);
+        return &entry;
+      }
+      if (entry.key == key && strncmp(entry.name, name, SLAB_ROOT_NAME_SZ) == 0) {
+        return &entry;
+      }
+    }
+    throw std::runtime_error("Too many slab roots");
+  }
+};
+
+// Slot size of the slab that holds the root table, and the slab id of that
+// slab in the range of slab ids of its allocator (see reserve_slab_ids)
+constexpr size_t SLAB_ROOTS_EXP = 11;
+constexpr int SLAB_ROOTS_S_ID = SLAB_ROOTS_EXP + 1;
+static_assert(sizeof(SlabRootTable) == (1UL << SLAB_ROOTS_EXP),
+              "Root table should fill its slot");
+
+// Key of the root named [name] (64 bit FNV-1a). Never 0, which marks
+// unused entries.
+uint64_t slab_root_key(const char *name) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (; *name != '\0'; ++name) {
+    h = (h ^ uint8_t(*name)) * 0x100000001b3ULL;
+  }
+  return h == 0 ? 1 : h;
+}
+
+// The root table in [slab], or null if it has none
+SlabRootTable* slab_roots_in(Slab *slab) {
+  if (slab == nullptr || size_t(slab->slab_md()->sz) != (1UL << SLAB_ROOTS_EXP) ||
+      slab->slab_md()->roots == 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<SlabRootTable*>(slab->blocks + slab->slab_md()->roots);
+}
+
+// Find the root table of the allocator of machine [m] whose range of slab
+// ids starts at [base], or null if it has none (yet)
+SlabRootTable* find_slab_roots(int m, int base = 0) {
+  return slab_roots_in(reinterpret_cast<Slab*>(slab_lookup_table[m][base + SLAB_ROOTS_S_ID]));
+}
+
+// Find the root of machine [m] with key [key] and name [name], or null if
+// there is none. Every allocator of [m] has a root table of its own, so
+// the table of each range of slab ids is searched, lowest first.
+template <typename T>
+fancy_pointer<T> find_slab_root(int m, uint64_t key, const char *name) {
+  for (int base = 0; base + SLAB_ROOTS_S_ID < slab_lookup_table[m].size();
+       base += SLAB_SIZE_CLASSES) {
+    SlabRootTable *roots = find_slab_roots(m, base);
+    SlabRootEntry *entry = (roots == nullptr) ? nullptr : roots->find(key, name);
+    if (entry != nullptr) {
+      return fancy_pointer<T>(entry->m_id, entry->s_id, entry->offset);
+    }
+  }
+  return nullptr;
+}
+
+// Find the root of machine [m] named [name], or null if there is none
+template <typename T>
+fancy_pointer<T> find_slab_root(int m, const char *name) {
+  return find_slab_root<T>(m, slab_root_key(name), name);
+}
+
+// Find the root of machine [m] with the id [id], or null if there is none
+// Precondition: [id] is not 0
+template <typename T>
+fancy_pointer<T> find_slab_root(int m, uint64_t id) {
+  return find_slab_root<T>(m, id, "");
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "slab.h"
+#include "slab_image.h"
+#include "slab_lookup_table.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+// Magic number at the start of every slab segment ("SSEG")
+constexpr uint32_t SLAB_SEGMENT_MAGIC = 0x53534547;
+
+// Default number of bytes reserved for each slab of a segment
+constexpr size_t SLAB_SEGMENT_REGION_SZ = 64UL << 20;
+
+// Number of slabs in a segment. The slab with [2^exp] byte slots is slab
+// [exp] of the segment, like in a SlabAllocatorInternal.
+constexpr int SLAB_SEGMENT_SLABS = SLAB_SIZE_CLASSES - 1;
+
+// Lock a process-shared mutex. If the process that held it died, the mutex
+// is recovered, but the slab it protected may have been left half updated.
+struct SegmentLock {
+  pthread_mutex_t *mux;
+
+  explicit SegmentLock(pthread_mutex_t *m) : mux(m) {
+    if (pthread_mutex_lock(mux) == EOWNERDEAD) {
+      pthread_mutex_consistent(mux);
+    }
+  }
+
+  SegmentLock(const SegmentLock&) = delete;
+  SegmentLock& operator=(const SegmentLock&) = delete;
+
+  ~SegmentLock() {
+    pthread_mutex_unlock(mux);
+  }
+};
+
+// The header at the start of a segment, which is shared by every process
+// that maps it
+struct SlabSegmentHeader {
+  uint32_t magic;
+
+  // Machine id that every fancy pointer into the segment has
+  int m_id;
+
+  // Number of bytes reserved for each slab
+  uint64_t region_sz;
+
+  // Held while creating a slab
+  pthread_mutex_t mux_slabs;
+
+  // Held while allocating from or freeing into each slab
+  pthread_mutex_t mux[SLAB_SEGMENT_SLABS];
+
+  // Whether the first block of each slab has been initialized
+  std::atomic<int> created[SLAB_SEGMENT_SLABS];
+};
+
+// A shared memory file that several processes allocate from at the same
+// time. The file starts with a SlabSegmentHeader (in a region of its own),
+// which is followed by a region of [region_sz] bytes for each slab. Regions
+// are reserved up front, so slabs grow in place and never move, and each
+// process can map the segment wherever it likes: fancy pointers are
+// offsets, and the only raw pointers in the blocks (BlockMD::start) are
+// never followed across processes.
+//
+// The lookup table of the segment is its list of regions: every process
+// registers a Slab for each region in its own slab lookup table, under the
+// machine id of the segment.
+// Note: the machine id of the segment must not be the machine id of any of
+// the processes that map it
+struct SlabSegment {
+  int fd;
+
+  // Start and length of the mapping of the whole segment
+  char *base;
+  size_t len;
+
+  SlabSegmentHeader *header;
+
+  // Map the shared memory file [f]. If it is empty, a segment is created in
+  // it for slabs of machine [m_id], with [region_sz] bytes reserved for each
+  // slab. Otherwise it must already hold a segment, which is attached to.
+  // The segment takes ownership of [f].
+  SlabSegment(int f, int m_id = -1, size_t region_sz = SLAB_SEGMENT_REGION_SZ)
+    : fd(f)
+  {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error("Could not stat the file of a slab segment");
+    }
+
+    bool create = st.st_size == 0;
+    if (create) {
+      if (m_id < 0 || m_id >= MAX_MACHINES || region_sz != round_pow2(region_sz) ||
+          region_sz < sizeof(SlabSegmentHeader)) {
+        close(fd);
+        throw std::runtime_error("Invalid machine id or region size for a slab segment");
+      }
+      if (ftruncate(fd, (SLAB_SEGMENT_SLABS + 1) * region_sz) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not grow the file of a slab segment");
+      }
+    } else {
+      // Find out the region size from the header of the segment
+      SlabSegmentHeader existing;
+      if (pread(fd, &existing, sizeof(existing), 0) != sizeof(existing) ||
+          existing.magic != SLAB_SEGMENT_MAGIC) {
+        close(fd);
+        throw std::runtime_error("File does not hold a slab segment");
+      }
+      region_sz = existing.region_sz;
+    }
+
+    // Aligning the mapping to the region size aligns every slab to the size
+    // of its blocks
+    len = (SLAB_SEGMENT_SLABS + 1) * region_sz;
+    base = map_aligned(fd, len, region_sz);
+    header = reinterpret_cast<SlabSegmentHeader*>(base);
+
+    if (create) {
+      header = new (base) SlabSegmentHeader();
+      header->m_id = m_id;
+      header->region_sz = region_sz;
+
+      pthread_mutexattr_t attr;
+      pthread_mutexattr_init(&attr);
+      pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+      pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+      pthread_mutex_init(&header->mux_slabs, &attr);
+      for (int i = 0; i < SLAB_SEGMENT_SLABS; ++i) {
+        pthread_mutex_init(&header->mux[i], &attr);
+        header->created[i].store(0);
+      }
+      pthread_mutexattr_destroy(&attr);
+
+      // Attaching processes check the magic number, so set it last
+      std::atomic_thread_fence(std::memory_order_release);
+      header->magic = SLAB_SEGMENT_MAGIC;
+    }
+  }
+
+  SlabSegment(const SlabSegment&) = delete;
+  SlabSegment& operator=(const SlabSegment&) = delete;
+
+  ~SlabSegment() {
+    munmap(base, len);
+    close(fd);
+  }
+
+  // Check if the slab with [2^exp] byte slots fits in a region
+  bool fits(size_t exp) {
+    return int(exp) < SLAB_SEGMENT_SLABS && (64UL << exp) <= header->region_sz;
+  }
+
+  // Create the Slab of this process for the slab with [2^exp] byte slots,
+  // and register it under the machine id of the segment. The slab may not
+  // have been initialized yet (see [initialize]).
+  Slab* attach(size_t exp) {
+    char *region = base + (exp + 1) * header->region_sz;
+    Slab *slab = new Slab(region, header->m_id, exp + 1);
+    slab->capacity = header->region_sz;
+    slab->index();
+    return slab;
+  }
+
+  // Initialize the first block of [slab], which has [2^exp] byte slots, if
+  // no process did so yet
+  void initialize(Slab *slab, size_t exp) {
+    if (header->created[exp].load(std::memory_order_acquire)) {
+      return;
+    }
+
+    SegmentLock lock(&header->mux_slabs);
+    if (!header->created[exp].load(std::memory_order_relaxed)) {
+      slab->nth_block(0)->initialize_head(slab, 1UL << exp);
+      header->created[exp].store(1, std::memory_order_release);
+    }
+  }
+
+  // Copy the blocks of the full or delta slab image in [buf], which is [len]
+  // bytes long, into the regions of the slabs they came from, so that
+  // offsets from the start of the sender's segment are offsets from the
+  // start of this one. The sender's segment must have had the same region
+  // size.
+  // Note: no other process may allocate from the segment meanwhile
+  void load(const char *buf, size_t len) {
+    SlabImageView view(buf, len);
+
+    size_t run = 0;
+    for (const SlabImageEntry& entry : view.entries) {
+      size_t exp = entry.s_id - 1;
+      if (!fits(exp) || size_t(entry.sz) != (1UL << exp) ||
+          size_t(entry.num_blocks) * 64*entry.sz > header->region_sz) {
+        throw std::runtime_error("Slab image does not fit in the slab segment");
+      }
+      if (!(view.header.flags & SLAB_IMAGE_DELTA) &&
+          (entry.num_runs != 1 || view.runs[run].num_blocks != entry.num_blocks)) {
+        throw std::runtime_error("Only full and delta slab images can be loaded");
+      }
+
+      char *region = base + entry.s_id * header->region_sz;
+      for (int r = 0; r < entry.num_runs; ++r, ++run) {
+        memcpy(region + size_t(view.runs[run].first_block) * 64*entry.sz,
+               buf + view.run_offsets[run],
+               size_t(view.runs[run].num_blocks) * 64*entry.sz);
+      }
+      header->created[exp].store(1, std::memory_order_release);
+    }
+  }
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "slab.h"
+#include "slab_image.h"
+#include "slab_lookup_table.h"
+
+// sendmsg, recvmsg, SCM_RIGHTS
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Send the header of [image] over the Unix domain socket [sock], along with
+// [fds], the files holding the blocks of its slabs (in the same order as the
+// entries of the image). The blocks themselves are not sent.
+void send_slab_fds(int sock, SlabImage& image, const std::vector<int>& fds) {
+  std::vector<char> control(CMSG_SPACE(fds.size() * sizeof(int)), 0);
+
+  iovec iov = image.iov[0];
+
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (!fds.empty()) {
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds.data(), fds.size() * sizeof(int));
+  }
+
+  if (sendmsg(sock, &msg, 0) != ssize_t(iov.iov_len)) {
+    throw std::runtime_error("Could not send the slabs");
+  }
+}
+
+// The slabs of another process on this host, mapped read-only from the files
+// that it sent with SlabAllocatorInternal::share_slabs. Like an
+// AdoptedSlabImage, the slabs are registered under the sender's machine id,
+// so fancy pointers created by the sender resolve into the mappings. Only
+// the header of the image is received: the blocks are the sender's own
+// memory, so its later writes are visible as well.
+// Note: only the blocks that existed when the slabs were shared are mapped,
+// so slabs have to be shared again after the sender resizes them
+// Note: [sock] should be a SOCK_SEQPACKET socket, so that the header is
+// received in one piece
+struct SharedSlabs {
+  // A read-only mapping of the file of one slab
+  struct Mapping {
+    char *addr;
+    size_t len;
+
+    Mapping(char *a, size_t l) : addr(a), len(l) {}
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+    ~Mapping() { munmap(addr, len); }
+  };
+
+  // Machine id of the sender
+  int m_id;
+
+  // The mappings of the files, which hold the blocks of [slabs]
+  std::vector<std::unique_ptr<Mapping>> mappings;
+
+  // The shared slabs, which are unregistered when this is destroyed
+  std::vector<std::unique_ptr<Slab>> slabs;
+
+  ~SharedSlabs() {
+    retire();
+  }
+
+  // Receive the slabs that were shared over the socket [sock]
+  explicit SharedSlabs(int sock) {
+    std::vector<char> buf(slab_image_header_size(SLAB_SIZE_CLASSES, SLAB_SIZE_CLASSES));
+    std::vector<char> control(CMSG_SPACE(SLAB_SIZE_CLASSES * sizeof(int)));
+
+    iovec iov = {buf.data(), buf.size()};
+
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    ssize_t len = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (len <= 0) {
+      throw std::runtime_error("Could not receive the slabs");
+    }
+
+    std::vector<int> fds;
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        size_t old_sz = fds.size();
+        fds.resize(old_sz + n);
+        memcpy(fds.data() + old_sz, CMSG_DATA(cmsg), n * sizeof(int));
+      }
+    }
+
+    try {
+      if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        throw std::runtime_error("Received a truncated slab image header");
+      }
+
+      SlabImageView view(buf.data(), len, false);
+
+      if (fds.size() != view.entries.size()) {
+        throw std::runtime_error("Received the wrong number of slab files");
+      }
+
+      m_id = view.header.m_id;
+
+      for (size_t i = 0; i < view.entries.size(); ++i) {
+        const SlabImageEntry& entry = view.entries[i];
+
+        if (slab_lookup_table[m_id][entry.s_id] != nullptr) {
+          throw std::runtime_error("Slab image has a duplicate slab id");
+        }
+        if (entry.num_runs != 1 || view.runs[i].num_blocks != entry.num_blocks) {
+          throw std::runtime_error("Only full slabs can be shared");
+        }
+
+        size_t bytes = size_t(entry.num_blocks) * 64*entry.sz;
+        void *addr = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fds[i], 0);
+        if (addr == MAP_FAILED) {
+          throw std::runtime_error("Could not map a shared slab");
+        }
+        mappings.emplace_back(new Mapping(static_cast<char*>(addr), bytes));
+
+        slabs.emplace_back(new Slab(static_cast<char*>(addr), m_id, entry.s_id));
+        check_slab_md(slabs.back().get(), entry);
+        slabs.back()->index();
+      }
+    } catch (...) {
+      retire();
+      for (int fd : fds) {
+        close(fd);
+      }
+      throw;
+    }
+
+    // The mappings keep the files alive
+    for (int fd : fds) {
+      close(fd);
+    }
+  }
+
+private:
+  // Unregister the slabs right away, and unmap their blocks once no
+  // SlabReadGuard can still be reading them (see slab_epoch.h)
+  void retire() {
+    retire_slabs(slabs);
+
+    auto retired = std::make_shared<std::vector<std::unique_ptr<Mapping>>>(std::move(mappings));
+    mappings.clear();
+    retire_slab_memory([retired]() { retired->clear(); });
+  }
+};
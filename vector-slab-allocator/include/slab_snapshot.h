@@ -0,0 +1,126 @@
+#pragma once
+
+#include "slab_image.h"
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <vector>
+
+// A consistent image of an allocator's slabs that is being exported while
+// the allocator keeps being used (see SlabAllocatorInternal::snapshot).
+// The image is frozen by forking: the export runs in a child process, whose
+// copy of the slabs is copy-on-write, so the kernel only copies the pages
+// that are written to before the export is done.
+struct SlabSnapshot {
+  // The process that exports the image, or -1 once it has been waited for
+  pid_t pid;
+
+  explicit SlabSnapshot(pid_t p) : pid(p) {}
+
+  SlabSnapshot(const SlabSnapshot&) = delete;
+  SlabSnapshot& operator=(const SlabSnapshot&) = delete;
+
+  SlabSnapshot(SlabSnapshot&& rhs) : pid(rhs.pid) {
+    rhs.pid = -1;
+  }
+
+  // Check if the export is done, without waiting for it
+  bool done() {
+    if (pid < 0) {
+      return true;
+    }
+
+    int status;
+    pid_t ret = waitpid(pid, &status, WNOHANG);
+    if (ret == 0) {
+      return false;
+    }
+    pid = -1;
+    if (ret < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      throw std::runtime_error("Could not export the slab snapshot");
+    }
+    return true;
+  }
+
+  // Wait for the export to be done
+  void wait() {
+    if (pid < 0) {
+      return;
+    }
+
+    int status;
+    pid_t ret = waitpid(pid, &status, 0);
+    pid = -1;
+    if (ret < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      throw std::runtime_error("Could not export the slab snapshot");
+    }
+  }
+
+  // Waits for the export, so that the child process is always reaped
+  ~SlabSnapshot() {
+    if (pid >= 0) {
+      int status;
+      waitpid(pid, &status, 0);
+    }
+  }
+};
+
+// Write all of the [n] buffers at [iov] to [fd], at most [max_iov] at a
+// time, and return false if a write fails. [iov] is used up in the process.
+// Note: only makes async-signal-safe calls, so that it can run in a child
+//       process that was forked from a process with several threads
+bool write_iov(int fd, iovec *iov, size_t n, size_t max_iov) {
+  while (n > 0) {
+    ssize_t w = writev(fd, iov, std::min(n, max_iov));
+    if (w < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    // Skip the buffers that were written, and the part of the last one
+    while (n > 0 && size_t(w) >= iov->iov_len) {
+      w -= iov->iov_len;
+      ++iov;
+      --n;
+    }
+    if (n > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + w;
+      iov->iov_len -= w;
+    }
+  }
+  return true;
+}
+
+// Write [image] to [fd] from a child process, and return the snapshot that
+// tracks it. The child exits with a non-zero status if a write fails.
+// The child only writes to [fd] and exits: other threads of this process
+// may hold locks (e.g. in malloc) at the time of the fork, which are never
+// released in the child, so it can't run arbitrary code.
+SlabSnapshot fork_slab_image(SlabImage& image, int fd) {
+  // Everything the child needs is set up before the fork, since it can't
+  // allocate
+  std::vector<iovec> iov = image.iov;
+  long max_iov = sysconf(_SC_IOV_MAX);
+  if (max_iov <= 0) {
+    max_iov = 16;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    throw std::runtime_error("Could not fork to export a slab snapshot");
+  }
+
+  if (pid == 0) {
+    _exit(write_iov(fd, iov.data(), iov.size(), max_iov) ? 0 : 1);
+  }
+
+  return SlabSnapshot(pid);
+}
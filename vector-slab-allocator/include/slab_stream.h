@@ -0,0 +1,95 @@
+#pragma once
+
+#include "slab.h"
+#include "slab_image.h"
+#include "slab_lookup_table.h"
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <map>
+
+// Streams the blocks of an allocator's slabs to a sink while a container is
+// still being built in them, so that sending overlaps building. Each block
+// is sent as soon as it is complete, i.e. once all of its slots have been
+// allocated, and the rest is sent at [flush].
+//
+// The blocks are sent as delta slab images (SLAB_IMAGE_DELTA), so the
+// receiver applies every image it gets to a SlabReplica. The first image of
+// each slab also holds its first block, which the replica needs to create
+// the slab.
+//
+// A block is not sent the moment its last slot is allocated, since the
+// object in that slot has not been constructed yet, and containers often
+// link a new node into the one before it. Instead it is held back until
+// [lag] more blocks of the same slab are complete.
+// Note: objects in a block that was sent must not be written to again,
+// unless they are marked dirty (see SlabAllocator::mark_dirty), in which
+// case the block is sent again at the next [flush]. This suits containers
+// that are appended to (e.g. lists and vectors of nodes), but not ones that
+// rewrite old nodes (e.g. balanced trees), which should use [flush] only.
+struct SlabStream {
+  using Sink = std::function<void(SlabImage&)>;
+
+  // Called with every image, which is only valid during the call
+  Sink sink;
+
+  // Number of complete blocks of each slab that are held back
+  size_t lag;
+
+  // The complete blocks of each slab that were not sent yet, by slab id
+  std::map<int, std::deque<int>> pending;
+
+  // Whether the first block of each slab was sent yet, by slab id
+  std::map<int, bool> started;
+
+  SlabStream(Sink s, size_t l) : sink(std::move(s)), lag(l) {}
+
+  // Record that the [n]th block of [slab] has no free slots left, and send
+  // the blocks that have been held back long enough
+  void block_full(Slab *slab, int n) {
+    std::deque<int>& blocks = pending[slab->s_id];
+    blocks.push_back(n);
+
+    while (blocks.size() > lag) {
+      int m = blocks.front();
+      blocks.pop_front();
+      send(slab, [m](Slab*, int i) { return i == m; });
+
+      // Sent as complete, so there is no need to send it again at the next
+      // flush unless it changes
+      slab->clear_dirty_block(m);
+    }
+  }
+
+  // Send every block of [slabs] (null entries are skipped) that was written
+  // to since it was last sent, including the ones held back
+  template <typename SlabArray>
+  void flush(const SlabArray& slabs) {
+    for (Slab* slab : slabs) {
+      if (slab == nullptr) {
+        continue;
+      }
+      send(slab, [](Slab* s, int i) { return s->is_dirty(i); });
+      slab->clear_dirty();
+      pending[slab->s_id].clear();
+    }
+  }
+
+  // Send the blocks of [slab] for which [include_block] is true, along
+  // with its first block if it was not sent yet
+  template <typename Pred>
+  void send(Slab *slab, Pred include_block) {
+    bool first = !started[slab->s_id];
+
+    std::array<Slab*, 1> slabs = {slab};
+    SlabImage image = make_slab_image(slabs, [&](Slab* s, int i) {
+      return (first && i == 0) || include_block(s, i);
+    }, SLAB_IMAGE_DELTA);
+
+    if (image.image_header()->num_slabs > 0) {
+      started[slab->s_id] = true;
+      sink(image);
+    }
+  }
+};
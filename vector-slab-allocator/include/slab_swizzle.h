@@ -0,0 +1,130 @@
+#pragma once
+
+#include "slab.h"
+#include "slab_layout.h"
+#include "slab_lookup_table.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// Swizzling rewrites the fancy pointers stored in a set of slabs (e.g. the
+// slabs of an AdoptedSlabImage) from (m_id, s_id, offset) into the raw form
+// (0, 0, address) that fancy_pointer already uses for objects outside of
+// slabs. Dereferencing a raw fancy pointer skips the slab lookup table, so
+// read-heavy traversals run at the speed of plain pointers. Unswizzling
+// turns them back, e.g. before the slabs are exported again.
+//
+// The fancy pointers are where the SlabPointerLayouts passed in say (see
+// slab_layout.h), and only the ones that point into a slab that is being
+// swizzled (or one past its end) are rewritten.
+// Note: the fancy pointers are rewritten in place, so swizzling adopted
+// slabs writes to their receive buffer
+// Note: fancy pointers outside the slabs (e.g. the header of a container
+// that was received separately) are not rewritten. Pass them to
+// [swizzle_pointer] so that they compare equal to the swizzled ones.
+
+// Rewrite the fancy pointer stored at [word] into the raw form, if it
+// points into a slab that is being swizzled. Returns true if it did.
+bool swizzle_word(char *word) {
+  int m, s;
+  int64_t offset;
+  memcpy(&m, word, sizeof(m));
+  memcpy(&s, word + sizeof(m), sizeof(s));
+  memcpy(&offset, word + 2*sizeof(int), sizeof(offset));
+
+  if (m < 0 || m >= MAX_MACHINES || s <= 0 || s >= MAX_SLAB_IDS) {
+    return false;
+  }
+  Slab *target = reinterpret_cast<Slab*>(slab_lookup_table[m][s]);
+  if (target == nullptr || !target->swizzled ||
+      offset < 0 || size_t(offset) > target->size()) {
+    return false;
+  }
+
+  int zero = 0;
+  int64_t addr = int64_t(target->blocks + offset);
+  memcpy(word, &zero, sizeof(zero));
+  memcpy(word + sizeof(m), &zero, sizeof(zero));
+  memcpy(word + 2*sizeof(int), &addr, sizeof(addr));
+  return true;
+}
+
+// Swizzle every fancy pointer into [slabs] (null entries are skipped) that
+// is stored in [slabs] where [layouts] place one. Returns the number of
+// fancy pointers rewritten.
+template <typename SlabArray>
+size_t swizzle_slabs(const SlabArray& slabs, const std::vector<SlabPointerLayout>& layouts) {
+  for (auto& slab : slabs) {
+    if (slab && slab->swizzled) {
+      throw std::runtime_error("Slab is already swizzled");
+    }
+  }
+  for (auto& slab : slabs) {
+    if (slab) {
+      slab->swizzled = true;
+    }
+  }
+
+  size_t count = 0;
+  for (auto& slab : slabs) {
+    if (slab) {
+      for_each_pointer(&*slab, layouts, [&](char *word) {
+        count += swizzle_word(word);
+      });
+    }
+  }
+  return count;
+}
+
+// Turn every raw fancy pointer into [slabs] that is stored in [slabs] where
+// [layouts] place one back into (m_id, s_id, offset). Returns the number of
+// fancy pointers rewritten.
+template <typename SlabArray>
+size_t unswizzle_slabs(const SlabArray& slabs, const std::vector<SlabPointerLayout>& layouts) {
+  std::vector<Slab*> targets;
+  for (auto& slab : slabs) {
+    if (slab && slab->swizzled) {
+      targets.push_back(&*slab);
+    }
+  }
+
+  size_t count = 0;
+  for (Slab *slab : targets) {
+    for_each_pointer(slab, layouts, [&](char *word) {
+      int m, s;
+      int64_t addr;
+      memcpy(&m, word, sizeof(m));
+      memcpy(&s, word + sizeof(m), sizeof(s));
+      memcpy(&addr, word + 2*sizeof(int), sizeof(addr));
+      if (m != 0 || s != 0) {
+        return;
+      }
+
+      for (Slab *target : targets) {
+        if (int64_t(target->blocks) <= addr &&
+            addr <= int64_t(target->blocks + target->size())) {
+          int64_t offset = addr - int64_t(target->blocks);
+          memcpy(word, &target->m_id, sizeof(m));
+          memcpy(word + sizeof(m), &target->s_id, sizeof(s));
+          memcpy(word + 2*sizeof(int), &offset, sizeof(offset));
+          ++count;
+          return;
+        }
+      }
+    });
+  }
+
+  for (Slab *slab : targets) {
+    slab->swizzled = false;
+  }
+  return count;
+}
+
+// Swizzle the fancy pointer [p], which is stored outside of the swizzled
+// slabs
+template <typename Ptr>
+void swizzle_pointer(Ptr& p) {
+  swizzle_word(reinterpret_cast<char*>(&p));
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "slab.h"
+#include "slab_lookup_table.h"
+#include "slab_layout.h"
+#include "slab_roots.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Validation of slabs received from an untrusted machine, before any fancy
+// pointer into them is followed. The metadata of each slab is checked first,
+// so that scanning its blocks stays inside of them, and then every fancy
+// pointer that the SlabPointerLayouts passed in place in the slabs (see
+// slab_layout.h) is checked: it must be null, or name one of the slabs,
+// with an offset inside of it (or one past its end). Raw fancy pointers and
+// fancy pointers to other machines (including this one) are invalid, since
+// following them would reach memory outside of the received slabs.
+
+// Check the metadata of [slab] that slab images don't already check (see
+// check_slab_md). Throws if it is invalid.
+void validate_slab_md(Slab *slab) {
+  SlabMD *md = slab->slab_md();
+  if (md->sz <= 0 || size_t(md->sz) != round_pow2(md->sz) ||
+      log2_int_ceil(md->sz) >= size_t(SLAB_SIZE_CLASSES)) {
+    throw std::runtime_error("Slab has an invalid slot size");
+  }
+  if (md->roots != 0 &&
+      (size_t(md->sz) != (1UL << SLAB_ROOTS_EXP) || md->roots % md->sz != 0 ||
+       md->roots + sizeof(SlabRootTable) > slab->size())) {
+    throw std::runtime_error("Slab has an invalid root table");
+  }
+}
+
+// Count the invalid fancy pointers that [layouts] place in blocks
+// [first, last) of [slab]. [limit[s]] is one more than the size of slab [s]
+// of machine [m], or 0 if it has no such slab (including past the end of
+// [limit]).
+size_t count_invalid_pointers(Slab *slab, int first, int last, int m,
+                              const std::vector<uint64_t>& limit,
+                              const std::vector<SlabPointerLayout>& layouts) {
+  int num_ids = limit.size();
+  size_t bad = 0;
+  for_each_pointer(slab, first, last, layouts, [&](char *word) {
+    // No branches depend on the data
+    int w_m, w_s;
+    uint64_t w_offset;
+    memcpy(&w_m, word, sizeof(w_m));
+    memcpy(&w_s, word + sizeof(int), sizeof(w_s));
+    memcpy(&w_offset, word + 2*sizeof(int), sizeof(w_offset));
+
+    // Null is (-1, -1, 0), and unused root table entries are all zeros
+    bool null = (((w_m == -1) & (w_s == -1)) | ((w_m == 0) & (w_s == 0))) &
+      (w_offset == 0);
+    bool claims = (w_m == m) & (w_s > 0) & (w_s < num_ids);
+    uint64_t lim = limit[claims ? w_s : 0];
+    bad += !null & (w_offset >= lim);
+  });
+  return bad;
+}
+
+// Count the invalid fancy pointers that [layouts] place in [slabs] (null
+// entries are skipped), which are the slabs of one machine, spreading the
+// blocks over [num_threads] threads. Throws if the metadata of a slab is
+// invalid, or if [layouts] don't fit its slots.
+template <typename SlabArray>
+size_t count_invalid_pointers(const SlabArray& slabs,
+                              const std::vector<SlabPointerLayout>& layouts,
+                              unsigned num_threads = 1) {
+  std::vector<uint64_t> limit(1, 0);
+  std::vector<Slab*> targets;
+  int m = -1;
+
+  for (auto& slab : slabs) {
+    if (!slab) {
+      continue;
+    }
+    if (m != -1 && slab->m_id != m) {
+      throw std::runtime_error("Slabs are from different machines");
+    }
+    m = slab->m_id;
+
+    validate_slab_md(&*slab);
+
+    // Check that the layouts fit, here rather than in the threads
+    for_each_pointer(&*slab, 0, 0, layouts, [](char*) {});
+
+    if (size_t(slab->s_id) >= limit.size()) {
+      limit.resize(slab->s_id + 1, 0);
+    }
+    limit[slab->s_id] = slab->size() + 1;
+    targets.push_back(&*slab);
+  }
+
+  // Split the slabs into chunks of blocks, which the threads take in turn
+  constexpr int chunk_blocks = 64;
+  struct Chunk {
+    Slab *slab;
+    int first;
+    int last;
+  };
+  std::vector<Chunk> chunks;
+  for (Slab *slab : targets) {
+    int num_blocks = slab->slab_md()->num_blocks;
+    for (int n = 0; n < num_blocks; n += chunk_blocks) {
+      chunks.push_back({slab, n, std::min(n + chunk_blocks, num_blocks)});
+    }
+  }
+
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> bad{0};
+  auto work = [&]() {
+    size_t my_bad = 0;
+    for (size_t c = next++; c < chunks.size(); c = next++) {
+      my_bad += count_invalid_pointers(chunks[c].slab, chunks[c].first,
+                                       chunks[c].last, m, limit, layouts);
+    }
+    bad += my_bad;
+  };
+
+  num_threads = std::max(1U, std::min<unsigned>(num_threads, chunks.size()));
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < num_threads; ++t) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  return bad;
+}
+
+// Check [slabs] (see [count_invalid_pointers]), and throw if any of them is
+// invalid
+template <typename SlabArray>
+void validate_slabs(const SlabArray& slabs, const std::vector<SlabPointerLayout>& layouts,
+                    unsigned num_threads = 1) {
+  if (count_invalid_pointers(slabs, layouts, num_threads) != 0) {
+    throw std::runtime_error("Slabs have invalid fancy pointers");
+  }
+}
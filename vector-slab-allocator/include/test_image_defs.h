@@ -0,0 +1,123 @@
+#pragma once
+
+#include "slab_image.h"
+#include "test_defs.h"
+#include <functional>
+#include <memory>
+#include <vector>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Fixtures for the tests that build a list in slabs, export the slabs and
+// check the list in another process
+
+// A node of a linked list of Tests, linked by [Ptr]s
+template <template <typename> class Ptr>
+struct TestNode {
+  Test value;
+  Ptr<TestNode> next;
+
+  TestNode(int id) : value(id), next(nullptr) {}
+};
+
+// Build a list of [n] nodes from [alloc], whose values are [first],
+// [first + step], ..., and return its head
+template <typename Alloc>
+typename std::allocator_traits<Alloc>::pointer
+make_list(Alloc& alloc, int n, int first = 0, int step = 1) {
+  typename std::allocator_traits<Alloc>::pointer head = nullptr;
+  for (int i = n - 1; i >= 0; --i) {
+    auto p = alloc.allocate(1);
+    new (&*p) typename Alloc::value_type(first + step*i);
+    p->next = head;
+    head = p;
+  }
+  return head;
+}
+
+// Check that the list at [head] is one that [make_list] built
+template <typename Pointer>
+void check_list(Pointer head, int n, int first = 0, int step = 1) {
+  int i = 0;
+  for (Pointer p = head; p != nullptr; p = p->next, ++i) {
+    assert(p->value == Test(first + step*i) && "Value at ith entry was incorrect");
+  }
+  assert(i == n && "List has the wrong length");
+}
+
+// Helpers for tests that send slabs from a sender process to a receiver
+// through a pipe
+
+void write_all(int fd, const void* buf, size_t len) {
+  ssize_t n = write(fd, buf, len);
+  assert(n == ssize_t(len));
+}
+
+void read_all(int fd, void* buf, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = read(fd, static_cast<char*>(buf) + done, len - done);
+    assert(n > 0 && "Sender closed the pipe early");
+    done += n;
+  }
+}
+
+// Write [image] to [fd], preceded by its size
+void write_image(int fd, SlabImage& image) {
+  uint64_t sz = image.size();
+  write_all(fd, &sz, sizeof(sz));
+  ssize_t n = writev(fd, image.iov.data(), image.iov.size());
+  assert(n == ssize_t(sz) && "writev did not write the whole image");
+}
+
+// Write the end of a stream of images to [fd]
+void write_end(int fd) {
+  uint64_t end = 0;
+  write_all(fd, &end, sizeof(end));
+}
+
+// Read an image that was written with [write_image], or nothing at the end
+// of a stream
+std::vector<char> read_image(int fd) {
+  uint64_t sz;
+  read_all(fd, &sz, sizeof(sz));
+  std::vector<char> buf(sz);
+  read_all(fd, buf.data(), sz);
+  return buf;
+}
+
+// A child process that runs a sender, which writes to a pipe
+struct SenderProcess {
+  pid_t pid;
+
+  // Read end of the pipe
+  int fd;
+};
+
+// Run [sender] in a child process, with the write end of a pipe
+SenderProcess fork_sender(const std::function<void(int)>& sender) {
+  int fds[2];
+  int rc = pipe(fds);
+  assert(rc == 0);
+  (void) rc;
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    sender(fds[1]);
+    close(fds[1]);
+    _exit(0);
+  }
+  close(fds[1]);
+  return SenderProcess{pid, fds[0]};
+}
+
+// Close the pipe of [sender], and check that it exited cleanly
+void join_sender(SenderProcess& sender) {
+  close(sender.fd);
+
+  int status;
+  waitpid(sender.pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "Sender failed");
+}
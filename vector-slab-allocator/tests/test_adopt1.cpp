@@ -0,0 +1,50 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <vector>
+
+// ==============================================================
+// = Test Adopt 1: Build a linked list on one machine, send its =
+// = slabs through a pipe, and traverse it on another machine   =
+// = directly in the receive buffer                             =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int const list_sz = 1000;
+
+// Build a list on machine 1, and write its head followed by its slab image
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  pointer head = make_list(slab_alloc, list_sz);
+
+  SlabImage image = slab_alloc.internal->export_slabs();
+
+  write_all(fd, &head, sizeof(head));
+  write_image(fd, image);
+}
+
+int main(void)
+{
+  SenderProcess proc = fork_sender(sender);
+
+  // Receive everything the sender wrote
+  pointer head;
+  read_all(proc.fd, (void*) &head, sizeof(head));
+  std::vector<char> buf = read_image(proc.fd);
+  join_sender(proc);
+
+  assert(head.m_id == 1 && "Pointer should have the sender's machine id");
+
+  AdoptedSlabImage image(buf.data(), buf.size());
+  assert(image.m_id == 1);
+
+  // Traverse the list in place
+  check_list(head, list_sz);
+  for (pointer p = head; p != nullptr; p = p->next) {
+    assert(pointer::pointer_to(*p) == p && "pointer_to should find the adopted slab");
+  }
+}
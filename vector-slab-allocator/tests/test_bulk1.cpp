@@ -0,0 +1,60 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// ==============================================================
+// = Test Bulk 1: Resolve fancy pointers into several slabs,    =
+// = along with null and raw ones, in a single call             =
+// ==============================================================
+
+int const num_pointers = 10000;
+
+int main(void)
+{
+  SlabAllocator<Test> alloc;
+  SlabAllocator<long> long_alloc;
+  Test local(-1);
+
+  std::vector<fancy_pointer<Test>> ptrs;
+  for (int i = 0; i < num_pointers; ++i) {
+    switch (i % 5) {
+      case 0:
+        ptrs.push_back(fancy_pointer<Test>(nullptr));
+        break;
+      case 1:
+        ptrs.push_back(fancy_pointer<Test>::pointer_to(local));
+        break;
+      case 2:
+        // A pointer into another slab, to the same type for the test
+        ptrs.push_back(fancy_pointer<Test>(long_alloc.allocate(1)));
+        break;
+      default:
+        ptrs.push_back(alloc.allocate(1));
+        break;
+    }
+  }
+
+  // Runs of pointers into the same slab, and no runs at all
+  std::vector<fancy_pointer<Test>> sorted = ptrs;
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const fancy_pointer<Test>& a, const fancy_pointer<Test>& b) {
+                     return a.s_id < b.s_id;
+                   });
+  std::vector<fancy_pointer<Test>> shuffled = ptrs;
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(0));
+
+  for (auto *v : {&ptrs, &sorted, &shuffled}) {
+    std::vector<Test*> addrs = to_addresses(*v);
+    assert(addrs.size() == v->size());
+    for (size_t i = 0; i < v->size(); ++i) {
+      assert(addrs[i] == fancy_pointer<Test>::to_address((*v)[i]) &&
+             "Bulk translation disagrees with to_address");
+    }
+  }
+
+  // Nothing to resolve
+  assert(to_addresses(std::vector<fancy_pointer<Test>>()).empty());
+}
@@ -0,0 +1,83 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// ==============================================================
+// = Test Cached 1: Follow fancy pointers through the slab      =
+// = cache of each thread while the slab moves, and after it is =
+// = replaced by another one                                    =
+// ==============================================================
+
+struct Node {
+  Test value;
+  cached_fancy_pointer<Node> next;
+
+  Node(int id) : value(id), next(nullptr) {}
+};
+
+using allocator_type = SlabAllocator<Node, cached_fancy_pointer>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+static_assert(std::is_same_v<pointer, cached_fancy_pointer<Node>>);
+
+// Enough nodes for the slab to be resized several times
+int const list_sz = 5000;
+int const num_threads = 4;
+
+void check_list(pointer head, int len) {
+  int i = 0;
+  for (pointer p = head; p != nullptr; p = p->next, ++i) {
+    assert(p->value == Test(i) && "Value at ith entry was incorrect");
+  }
+  assert(i == len && "List has the wrong length");
+}
+
+int main(void)
+{
+  {
+    allocator_type slab_alloc;
+    pointer head = nullptr;
+    pointer tail = nullptr;
+
+    // Follow the tail after every allocation, which moves the blocks
+    // whenever the slab is resized
+    for (int i = 0; i < list_sz; ++i) {
+      pointer p = slab_alloc.allocate(1);
+      new (&*p) Node(i);
+      if (tail == nullptr) {
+        head = p;
+      } else {
+        assert(tail->value == Test(i - 1) && "Followed a stale slab address");
+        tail->next = p;
+      }
+      tail = p;
+
+      fancy_pointer<Node> full = p;
+      assert(&*full == &*p);
+    }
+
+    // Each thread has a cache of its own
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+      threads.emplace_back([head]() { check_list(head, list_sz); });
+    }
+    for (std::thread& t : threads) {
+      t.join();
+    }
+    check_list(head, list_sz);
+  }
+
+  // A new slab in the same entry of the slab lookup table
+  allocator_type slab_alloc;
+  pointer p = slab_alloc.allocate(1);
+  new (&*p) Node(7);
+  assert(p->value == Test(7) && p == pointer::pointer_to(*p));
+
+  pointer raw = pointer::pointer_to(*new Node(8));
+  assert(raw.s_id == 0 && raw->value == Test(8));
+  delete &*raw;
+  assert(pointer() == nullptr);
+}
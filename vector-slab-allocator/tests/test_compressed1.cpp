@@ -0,0 +1,146 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// ==============================================================
+// = Test Compressed 1: Build a linked list with compressed 4   =
+// = byte pointers, and traverse it on another machine after    =
+// = loading an image of it into a segment of its own           =
+// ==============================================================
+
+struct list_tag {};
+
+template <typename T>
+using list_pointer = compressed_pointer<T, list_tag>;
+
+struct Node {
+  Test value;
+  list_pointer<Node> next;
+
+  Node(int id) : value(id), next(nullptr) {}
+};
+
+using allocator_type = SlabAllocator<Node, list_pointer>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+static_assert(std::is_same_v<pointer, compressed_pointer<Node, list_tag>>);
+static_assert(sizeof(pointer) == 4);
+
+int const list_sz = 1000;
+
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc = make_compressed_allocator<Node, list_pointer>(10);
+  pointer head = nullptr;
+
+  for (int i = list_sz - 1; i >= 0; --i) {
+    pointer p = slab_alloc.allocate(1);
+    new (&*p) Node(i);
+    p->next = head;
+    head = p;
+  }
+
+  // Objects outside of the region have no compressed pointer
+  Node local(-1);
+  bool threw = false;
+  try {
+    pointer::pointer_to(local);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw && "Compressed pointer to an object outside of the region");
+
+  // The tag already has a region, whose pointers would silently be
+  // repointed at a second one
+  threw = false;
+  try {
+    make_compressed_allocator<Node, list_pointer>(12);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw && "Attached a second region to the tag");
+  assert(pointer::pointer_to(*head) == head);
+
+  // Rebinding keeps the pointer type and the region
+  using other_alloc = std::allocator_traits<allocator_type>::rebind_alloc<int>;
+  static_assert(std::is_same_v<other_alloc::pointer, compressed_pointer<int, list_tag>>);
+  other_alloc int_alloc(slab_alloc);
+  list_pointer<int> ip = int_alloc.allocate(1);
+  *ip = 5;
+  assert(list_pointer<int>::pointer_to(*ip) == ip);
+  int_alloc.deallocate(ip, 1);
+
+  SlabImage image = slab_alloc.internal->export_slabs();
+
+  ssize_t n = write(fd, &head, sizeof(head));
+  assert(n == sizeof(head));
+  n = writev(fd, image.iov.data(), image.iov.size());
+  assert(n == ssize_t(image.size()) && "writev did not write the whole image");
+}
+
+int main(void)
+{
+  int fds[2];
+  int rc = pipe(fds);
+  assert(rc == 0);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    sender(fds[1]);
+    close(fds[1]);
+    _exit(0);
+  }
+  close(fds[1]);
+
+  std::vector<char> buf;
+  char chunk[4096];
+  ssize_t n;
+  while ((n = read(fds[0], chunk, sizeof(chunk))) > 0) {
+    buf.insert(buf.end(), chunk, chunk + n);
+  }
+  close(fds[0]);
+
+  int status;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "Sender failed");
+
+  set_machine_id(2);
+
+  // The offsets are relative to the segment, so the list can be followed
+  // wherever this segment is mapped
+  allocator_type slab_alloc = make_compressed_allocator<Node, list_pointer>(11);
+  pointer head;
+  memcpy((void*) &head, buf.data(), sizeof(head));
+  slab_alloc.internal->segment->load(buf.data() + sizeof(head), buf.size() - sizeof(head));
+
+  int i = 0;
+  for (pointer p = head; p != nullptr; p = p->next, ++i) {
+    assert(p->value == Test(i) && "Value at ith entry was incorrect");
+    assert(pointer::pointer_to(*p) == p);
+  }
+  assert(i == list_sz && "List has the wrong length");
+
+  // Allocating after the load continues where the sender left off
+  pointer p = slab_alloc.allocate(1);
+  for (pointer q = head; q != nullptr; q = q->next) {
+    assert(q != p && "Allocated a slot that was in use");
+  }
+  slab_alloc.deallocate(p, 1);
+
+  // Destroying the allocator detaches its segment, so another one can be
+  // attached to the tag
+  slab_alloc.internal.reset();
+  assert(compressed_region<list_tag>::base == nullptr);
+  allocator_type other_alloc = make_compressed_allocator<Node, list_pointer>(12);
+  assert(compressed_region<list_tag>::base == other_alloc.internal->segment->base);
+  other_alloc.deallocate(other_alloc.allocate(1), 1);
+
+  std::cout << "Node with compressed pointers: " << sizeof(Node) << " bytes" << std::endl;
+}
@@ -0,0 +1,80 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// ==============================================================
+// = Test Delta 1: Send a full image of a linked list, change a =
+// = few nodes, and send only the blocks that changed. The      =
+// = replica on the receiver matches the list after each image  =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int const list_sz = 5000;
+int const num_changed = 10;
+int const num_added = 5;
+
+// Each image is preceded by the head of the list
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  pointer head = make_list(slab_alloc, list_sz);
+
+  SlabImage full = slab_alloc.internal->export_slabs();
+  write_all(fd, &head, sizeof(head));
+  write_image(fd, full);
+
+  // Change a few nodes in place...
+  pointer p = head;
+  for (int i = 0; i < num_changed; ++i, p = p->next) {
+    p->value.id += list_sz;
+    slab_alloc.mark_dirty(p);
+  }
+
+  // ... and add a few nodes to the front
+  for (int i = 0; i < num_added; ++i) {
+    pointer q = slab_alloc.allocate(1);
+    new (&*q) Node(-1 - i);
+    q->next = head;
+    head = q;
+  }
+
+  SlabImage delta = slab_alloc.internal->export_delta();
+  assert(delta.size() * 10 < full.size() && "Delta should be much smaller");
+  write_all(fd, &head, sizeof(head));
+  write_image(fd, delta);
+}
+
+int main(void)
+{
+  SenderProcess proc = fork_sender(sender);
+
+  SlabReplica replica;
+  pointer head;
+
+  read_all(proc.fd, (void*) &head, sizeof(head));
+  std::vector<char> full = read_image(proc.fd);
+  replica.apply(full.data(), full.size());
+  check_list(head, list_sz);
+
+  read_all(proc.fd, (void*) &head, sizeof(head));
+  std::vector<char> delta = read_image(proc.fd);
+  std::cout << "Full image: " << full.size() << " bytes, delta: "
+            << delta.size() << " bytes" << std::endl;
+  replica.apply(delta.data(), delta.size());
+
+  int i = -num_added;
+  for (pointer p = head; p != nullptr; p = p->next, ++i) {
+    int expected = (0 <= i && i < num_changed) ? i + list_sz : i;
+    std::cout << "Element " << i << ": " << p->value.id << std::endl;
+    assert(p->value == Test(expected) && "Value at ith entry was incorrect");
+  }
+  assert(i == list_sz && "List has the wrong length");
+
+  join_sender(proc);
+}
@@ -0,0 +1,135 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// ==============================================================
+// = Test Evict 1: Adopt the slabs of thousands of machines,    =
+// = evict half of them while another thread follows pointers  =
+// = into them, and check that no receive buffer is released    =
+// = while the reader may still be using it                     =
+// ==============================================================
+
+int const num_peers = 2000;
+
+// Make the image of a slab of machine [m] that holds [value], and return
+// a pointer to the value
+fancy_pointer<long> make_image(int m, long value, std::vector<char>& buf) {
+  set_machine_id(m);
+
+  SlabAllocator<long> alloc;
+  fancy_pointer<long> p = alloc.allocate(1);
+  *p = value;
+
+  SlabImage image = alloc.internal->export_slabs();
+  buf.clear();
+  for (const iovec& v : image.iov) {
+    buf.insert(buf.end(), (char*) v.iov_base, (char*) v.iov_base + v.iov_len);
+  }
+
+  // The slab of the allocator stays with machine [m]
+  set_machine_id(0);
+  assert(*p == value && "Slab should stay with the old machine id");
+  return p;
+}
+
+int main(void)
+{
+  std::vector<std::vector<char>*> bufs(num_peers + 1);
+  std::vector<fancy_pointer<long>> ptrs(num_peers + 1);
+  std::vector<std::unique_ptr<AdoptedSlabImage>> images(num_peers + 1);
+  std::unique_ptr<std::atomic<bool>[]> released(new std::atomic<bool>[num_peers + 1]);
+
+  for (int m = 1; m <= num_peers; ++m) {
+    bufs[m] = new std::vector<char>();
+    ptrs[m] = make_image(m, m, *bufs[m]);
+    images[m].reset(new AdoptedSlabImage(bufs[m]->data(), bufs[m]->size()));
+    released[m] = false;
+  }
+
+  for (int m = 1; m <= num_peers; ++m) {
+    assert(*ptrs[m] == m && "Pointer should resolve into the adopted slab");
+    assert(fancy_pointer<long>::pointer_to(*ptrs[m]) == ptrs[m]);
+  }
+
+  // Remember where the slab of machine 2 is in the slab cache
+  cached_fancy_pointer<long> cached(ptrs[2]);
+  assert(*cached == 2);
+
+  // Follow pointers into the slabs of every machine, while they are evicted
+  std::atomic<bool> done{false};
+  std::atomic<long> reads{0};
+  std::thread reader([&]() {
+    while (!done.load()) {
+      for (int m = 1; m <= num_peers; ++m) {
+        SlabReadGuard guard;
+        Slab *slab = reinterpret_cast<Slab*>(slab_lookup_table[m][ptrs[m].s_id]);
+        if (slab == nullptr) {
+          continue;
+        }
+        long *p = (long*) (slab->blocks + ptrs[m].offset);
+        for (volatile int i = 0; i < 100; ++i) {}
+        assert(*p == m && "Slab changed under the reader");
+        assert(!released[m] && "Buffer released while the reader could use it");
+      }
+      ++reads;
+    }
+  });
+
+  for (int m = 2; m <= num_peers; m += 2) {
+    evict_machine(m);
+    images[m].reset();
+    std::vector<char> *buf = bufs[m];
+    std::atomic<bool> *flag = &released[m];
+    retire_slab_memory([buf, flag]() {
+      flag->store(true);
+      delete buf;
+    });
+    if (m % 200 == 0) {
+      for (long r = reads.load(); reads.load() < r + 1; ) {}
+    }
+  }
+  done = true;
+  reader.join();
+  std::cout << "Reads while evicting: " << reads << std::endl;
+
+  // Every retired buffer is released once there are no readers
+  synchronize_slab_readers();
+  for (int m = 1; m <= num_peers; ++m) {
+    if (m % 2 == 0) {
+      assert(released[m] && "Retired buffer should be released");
+      assert(slab_lookup_table[m].size() == 0 && "Evicted machine should have no row");
+      assert(!ptrs[m] && "Pointer into an evicted machine should not resolve");
+      assert(slab_index_lookup(bufs[m - 1]->data()) != 0 && "Other machines stay indexed");
+    } else {
+      assert(!released[m]);
+      assert(*ptrs[m] == m && "Machines that were not evicted stay adopted");
+    }
+  }
+
+  // A machine can come back after it was evicted, and the slab cache does
+  // not hand out the blocks of its old slab
+  std::vector<char> again;
+  fancy_pointer<long> p = make_image(2, -2, again);
+  AdoptedSlabImage readopted(again.data(), again.size());
+  assert(p.s_id == ptrs[2].s_id && p.offset == ptrs[2].offset);
+  assert(*ptrs[2] == -2 && "Pointer should resolve into the new slab");
+  assert(*cached == -2 && "Cached pointer should resolve into the new slab");
+
+  // The slabs of this machine can't be evicted
+  bool threw = false;
+  try {
+    evict_machine(M_ID);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw);
+
+  for (int m = 1; m <= num_peers; m += 2) {
+    images[m].reset();
+    delete bufs[m];
+  }
+}
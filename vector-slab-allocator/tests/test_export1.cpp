@@ -0,0 +1,70 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <array>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <unistd.h>
+
+// ==============================================================
+// = Test Export 1: Export the slabs of a slab allocator as a   =
+// = scatter-gather list, write it with writev, and check that  =
+// = the bytes written are exactly the header and the blocks    =
+// ==============================================================
+
+using value_type = Test;
+using allocator_type = SlabAllocator<value_type>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int main(void)
+{
+  allocator_type slab_alloc;
+  SlabAllocator<int> int_alloc{slab_alloc};
+
+  int const arr_sz = 100;
+  std::array<pointer, arr_sz> entries;
+
+  for (int i = 0; i < arr_sz; ++i) {
+    entries[i] = slab_alloc.allocate(1);
+    *(entries[i]) = i;
+  }
+  *int_alloc.allocate(1) = 42;
+
+  SlabImage image = slab_alloc.internal->export_slabs();
+
+  // One iovec for the header, and one for each of the two slabs
+  assert(image.iov.size() == 3 && "Expected a header and two slabs");
+  assert(image.image_header()->magic == SLAB_IMAGE_MAGIC);
+  assert(image.image_header()->num_slabs == 2);
+  assert(image.iov[0].iov_len % SLAB_IMAGE_ALIGN == 0);
+
+  // Slabs are exported in order of their size class
+  Slab* int_slab  = slab_alloc.internal->slabs[log2_int_ceil(sizeof(int))];
+  Slab* test_slab = slab_alloc.internal->slabs[log2_int_ceil(sizeof(value_type))];
+  assert(image.iov[1].iov_base == int_slab->blocks);
+  assert(image.iov[2].iov_base == test_slab->blocks);
+  assert(image.entries()[1].sz == int(round_pow2(sizeof(value_type))));
+  assert(image.entries()[1].s_id == entries[0].s_id);
+  assert(image.iov[2].iov_len ==
+         size_t(test_slab->slab_md()->num_blocks) * 64*image.entries()[1].sz);
+
+  // Write the image with a single writev, and read it back
+  FILE* f = tmpfile();
+  ssize_t written = writev(fileno(f), image.iov.data(), image.iov.size());
+  assert(written == ssize_t(image.size()) && "writev did not write the whole image");
+
+  std::vector<char> buf(image.size());
+  ssize_t n = pread(fileno(f), buf.data(), buf.size(), 0);
+  assert(n == ssize_t(buf.size()));
+  fclose(f);
+
+  // Find the slab of Test objects in the buffer, and check every entry
+  char* test_blocks = buf.data() + image.iov[0].iov_len + image.iov[1].iov_len;
+  for (int i = 0; i < arr_sz; ++i) {
+    value_type* v = reinterpret_cast<value_type*>(test_blocks + entries[i].offset);
+    std::cout << "Element " << i << ": " << *v << std::endl;
+    assert(*v == value_type(i) && "Value at ith entry was incorrect");
+    slab_alloc.deallocate(entries[i], 1);
+  }
+}
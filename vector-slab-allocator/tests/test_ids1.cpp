@@ -0,0 +1,123 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// ==============================================================
+// = Test Ids 1: Every allocator gets a range of slab ids of    =
+// = its own, which stand-alone slabs stay out of, so that its  =
+// = image only holds ids from its range                        =
+// ==============================================================
+
+int const num_values = 1000;
+
+// Check that every slab of [alloc] has an id in the range of [alloc]
+void check_range(SlabAllocatorInternal& alloc) {
+  for (int exp = 0; exp < alloc.MAX_SLABS; ++exp) {
+    Slab *slab = alloc.slabs[exp];
+    if (slab != nullptr) {
+      assert(slab->s_id == alloc.id_base + exp + 1 && "Slab id should be in the range");
+    }
+  }
+}
+
+int main(void)
+{
+  // The first allocator gets the ids of the size classes
+  SlabAllocator<long> first;
+  fancy_pointer<long> p = first.allocate(1);
+  *p = 7;
+  assert(first.internal->id_base == 0);
+  assert(p.s_id == int(log2_int_ceil(sizeof(long))) + 1);
+
+  // A slab on its own does not take an id of the first allocator, even
+  // though its size class id is free
+  Slab alone(sizeof(int));
+  assert(alone.s_id > SLAB_SIZE_CLASSES && "Stand-alone slab took a reserved id");
+
+  // Allocators with slabs of the same sizes get distinct ranges, and the
+  // range of the stand-alone slab is left out
+  SlabAllocator<long> a;
+  std::unique_ptr<SlabAllocator<long>> b(new SlabAllocator<long>());
+  SlabAllocator<int> a_ints{a};
+  assert(a.internal->id_base != b->internal->id_base);
+  assert((alone.s_id - 1) / SLAB_SIZE_CLASSES != a.internal->id_base / SLAB_SIZE_CLASSES);
+  assert((alone.s_id - 1) / SLAB_SIZE_CLASSES != b->internal->id_base / SLAB_SIZE_CLASSES);
+
+  std::vector<fancy_pointer<long>> in_a, in_b;
+  for (int i = 0; i < num_values; ++i) {
+    in_a.push_back(a.allocate(1));
+    *in_a.back() = i;
+    in_b.push_back(b->allocate(1));
+    *in_b.back() = -i;
+  }
+  *a_ints.allocate(1) = 42;
+
+  check_range(*first.internal);
+  check_range(*a.internal);
+  check_range(*b->internal);
+
+  for (int i = 0; i < num_values; ++i) {
+    assert(*in_a[i] == i && *in_b[i] == -i && "Pointers of allocators aliased");
+    assert(fancy_pointer<long>::pointer_to(*in_a[i]) == in_a[i]);
+  }
+
+  // The image of an allocator only holds ids from its range
+  SlabImage image = a.internal->export_slabs();
+  assert(image.image_header()->num_slabs == 2);
+  for (int i = 0; i < image.image_header()->num_slabs; ++i) {
+    int s = image.entries()[i].s_id;
+    assert(a.internal->id_base < s && s <= a.internal->id_base + SLAB_SIZE_CLASSES);
+  }
+
+  // The range of an allocator is free again once it is destroyed
+  int b_base = b->internal->id_base;
+  in_b.clear();
+  b.reset();
+  SlabAllocator<long> c;
+  assert(c.internal->id_base == b_base && "Range should have been released");
+
+  // The slabs of a slab segment have the ids of the first range of its
+  // machine, which the first allocator has, so the segment is refused
+  // instead of taking over the slabs of that allocator
+  bool threw = false;
+  try {
+    SlabAllocator<long> seg(shared_segment, memfd_create("ids", MFD_CLOEXEC), M_ID);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw && "Segment took the slab ids of an allocator");
+  threw = false;
+  try {
+    make_compressed_allocator<long, default_compressed_pointer>(M_ID);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw && "Compressed allocator took the slab ids of an allocator");
+  assert(*p == 7 && fancy_pointer<long>::pointer_to(*p) == p);
+
+  // On a machine of its own, the segment reserves the first range, and
+  // releases it again
+  int seg_m_id = M_ID + 1;
+  {
+    SlabAllocator<long> seg(shared_segment, memfd_create("ids", MFD_CLOEXEC), seg_m_id);
+    fancy_pointer<long> q = seg.allocate(1);
+    assert(q.m_id == seg_m_id && q.s_id == p.s_id);
+    assert(reserve_slab_ids(seg_m_id) != 0 && "Segment should have the first range");
+  }
+  assert(reserve_slab_ids(seg_m_id) == 0 && "Segment should have released its range");
+
+  // There is a limited number of ranges
+  std::vector<std::unique_ptr<SlabAllocatorInternal>> many;
+  threw = false;
+  try {
+    for (int i = 0; i <= SLAB_ID_RANGES; ++i) {
+      many.emplace_back(new SlabAllocatorInternal());
+    }
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw && "Reserving more ranges than there are should throw");
+  std::cout << "Allocators created before running out of ids: " << many.size() << std::endl;
+}
@@ -0,0 +1,70 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// ==============================================================
+// = Test Index 1: Check that pointer_to through the slab index =
+// = agrees with scanning the slab lookup table, as slabs are   =
+// = created, resized and destroyed                             =
+// ==============================================================
+
+template <typename T>
+void check(T& r) {
+  fancy_pointer<T> indexed = fancy_pointer<T>::pointer_to(r);
+  fancy_pointer<T> scanned = fancy_pointer<T>::scan_pointer_to(r);
+  assert(indexed.m_id == scanned.m_id && indexed.s_id == scanned.s_id &&
+         indexed.offset == scanned.offset && "Index and scan disagree");
+  assert(&*indexed == &r);
+}
+
+int const num_objects = 5000;
+
+int main(void)
+{
+  std::vector<char*> freed;
+
+  {
+    SlabAllocator<char> alloc;
+    std::vector<char*> objects;
+
+    // Slabs of many sizes, some of which share granules of the index, and
+    // some of which are resized many times
+    for (int i = 0; i < num_objects; ++i) {
+      size_t n = size_t(1) << (i % 16);
+      fancy_pointer<char> p = alloc.allocate(n);
+      objects.push_back(&*p);
+    }
+
+    for (char *p : objects) {
+      check(*p);
+      check(p[1]);
+    }
+
+    // One past the end of a slab
+    for (Slab *slab : alloc.internal->slabs) {
+      if (slab != nullptr) {
+        char *end = slab->blocks + slab->size();
+        fancy_pointer<char> p = fancy_pointer<char>::pointer_to(*end);
+        assert(p.s_id == slab->s_id && p.offset == ptrdiff_t(slab->size()));
+      }
+    }
+
+    freed = objects;
+  }
+
+  // Objects outside of slabs, including the ones of slabs that are gone
+  Test local(1);
+  check(local);
+  for (int i = 0; i < num_objects; i += 97) {
+    fancy_pointer<char> p = fancy_pointer<char>::pointer_to(*freed[i]);
+    assert(p.s_id == 0 && "Pointer into a slab that was destroyed");
+  }
+
+  // A slab that reserves its memory up front is indexed as a whole
+  SlabAllocator<Test> segment_alloc(shared_segment, memfd_create("index", MFD_CLOEXEC), 5);
+  fancy_pointer<Test> p = segment_alloc.allocate(1);
+  check(*p);
+  segment_alloc.deallocate(p, 1);
+}
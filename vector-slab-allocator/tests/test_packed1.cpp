@@ -0,0 +1,106 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// ==============================================================
+// = Test Packed 1: Build a linked list with packed 8 byte      =
+// = fancy pointers, check that they point where full fancy     =
+// = pointers do, and traverse the list on another machine      =
+// ==============================================================
+
+struct Node {
+  Test value;
+  packed_fancy_pointer<Node> next;
+
+  Node(int id) : value(id), next(nullptr) {}
+};
+
+using allocator_type = SlabAllocator<Node, packed_fancy_pointer>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+static_assert(std::is_same_v<pointer, packed_fancy_pointer<Node>>);
+static_assert(sizeof(pointer) == 8);
+
+int const list_sz = 1000;
+
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  pointer head = nullptr;
+
+  for (int i = list_sz - 1; i >= 0; --i) {
+    pointer p = slab_alloc.allocate(1);
+    new (&*p) Node(i);
+    p->next = head;
+    head = p;
+
+    fancy_pointer<Node> full = fancy_pointer<Node>::pointer_to(*p);
+    assert(p.m_id() == full.m_id && p.s_id() == full.s_id &&
+           p.offset() == size_t(full.offset));
+  }
+
+  // Objects outside of slabs get raw addresses
+  Node local(-1);
+  pointer raw = pointer::pointer_to(local);
+  assert(&*raw == &local && raw != nullptr);
+
+  // Rebinding keeps the pointer type
+  using other_alloc = std::allocator_traits<allocator_type>::rebind_alloc<int>;
+  static_assert(std::is_same_v<other_alloc::pointer, packed_fancy_pointer<int>>);
+  other_alloc int_alloc(slab_alloc);
+  packed_fancy_pointer<int> ip = int_alloc.allocate(1);
+  *ip = 5;
+  int_alloc.deallocate(ip, 1);
+
+  SlabImage image = slab_alloc.internal->export_slabs();
+
+  ssize_t n = write(fd, &head, sizeof(head));
+  assert(n == sizeof(head));
+  n = writev(fd, image.iov.data(), image.iov.size());
+  assert(n == ssize_t(image.size()) && "writev did not write the whole image");
+}
+
+int main(void)
+{
+  int fds[2];
+  int rc = pipe(fds);
+  assert(rc == 0);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    sender(fds[1]);
+    close(fds[1]);
+    _exit(0);
+  }
+  close(fds[1]);
+
+  std::vector<char> buf;
+  char chunk[4096];
+  ssize_t n;
+  while ((n = read(fds[0], chunk, sizeof(chunk))) > 0) {
+    buf.insert(buf.end(), chunk, chunk + n);
+  }
+  close(fds[0]);
+
+  int status;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "Sender failed");
+
+  pointer head;
+  memcpy((void*) &head, buf.data(), sizeof(head));
+  AdoptedSlabImage image(buf.data() + sizeof(head), buf.size() - sizeof(head));
+
+  int i = 0;
+  for (pointer p = head; p != nullptr; p = p->next, ++i) {
+    assert(p->value == Test(i) && "Value at ith entry was incorrect");
+    assert(pointer::pointer_to(*p) == p);
+  }
+  assert(i == list_sz && "List has the wrong length");
+  std::cout << "Node with packed pointers: " << sizeof(Node) << " bytes" << std::endl;
+}
@@ -0,0 +1,51 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+
+// ==============================================================
+// = Test Packed 2: A packed fancy pointer can't hold an offset =
+// = past the 36 bits of its offset field, so pointer_to throws =
+// = instead of spilling into the slab id                       =
+// ==============================================================
+
+int main(void)
+{
+  // A slab of one block with 1 GiB slots spans 64 GiB, so the address one
+  // past it has an offset of 2^36. Only the address space is reserved.
+  size_t slab_sz = 64ULL << 30;
+  char *b = (char*) mmap(nullptr, slab_sz + 4096, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  assert(b != MAP_FAILED);
+  int rc = mprotect(b, 4096, PROT_READ | PROT_WRITE);
+  assert(rc == 0);
+
+  int base = reserve_slab_ids(M_ID);
+  Slab slab(b, M_ID, base + 1);
+  reinterpret_cast<Block*>(b)->initialize_head(&slab, 1 << 30);
+  slab.index();
+  assert(slab.size() == slab_sz);
+
+  // The last offset that fits
+  long *last = (long*) (b + packed_fancy_pointer<long>::OFFSET_MASK);
+  packed_fancy_pointer<long> p = packed_fancy_pointer<long>::pointer_to(*last);
+  assert(p.m_id() == M_ID && p.s_id() == base + 1);
+  assert(p.offset() == packed_fancy_pointer<long>::OFFSET_MASK);
+
+  // One more byte would carry into the slab id
+  long *past = (long*) (b + slab_sz);
+  assert(fancy_pointer<long>::pointer_to(*past).offset == long(slab_sz));
+  bool threw = false;
+  try {
+    packed_fancy_pointer<long>::pointer_to(*past);
+  } catch (std::runtime_error& e) {
+    std::cout << "pointer_to threw: " << e.what() << std::endl;
+    threw = true;
+  }
+  assert(threw && "Offset past the offset bits should be refused");
+
+  slab.unregister();
+  release_slab_ids(M_ID, base);
+  munmap(b, slab_sz + 4096);
+}
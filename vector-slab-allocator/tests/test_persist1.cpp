@@ -0,0 +1,87 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <iostream>
+#include <string>
+
+// ==============================================================
+// = Test Persist 1: Build a linked list in file-backed slabs   =
+// = in one process, and reopen the files with a new allocator  =
+// = in another. The list is valid again without deserializing. =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int const list_sz = 1000;
+
+// Build the list in the files in [dir], and write its head to [fd]
+void writer(const std::string& dir, int fd) {
+  allocator_type slab_alloc(dir);
+
+  pointer head = make_list(slab_alloc, list_sz);
+
+  Slab* slab = slab_alloc.internal->slabs[log2_int_ceil(sizeof(Node))];
+  assert(slab->fd >= 0 && "Slab should be backed by a file");
+  assert(slab->slab_md()->num_blocks > 1 && "Slab should have resized");
+
+  check_list(head, list_sz);
+  slab_alloc.internal->sync();
+
+  write_all(fd, &head, sizeof(head));
+}
+
+int main(void)
+{
+  char dir_template[] = "/tmp/slab_persist_XXXXXX";
+  std::string dir = mkdtemp(dir_template);
+
+  // Write the files in another process, so that nothing of them is left in
+  // the slab lookup table of this one
+  SenderProcess proc = fork_sender([&dir](int fd) { writer(dir, fd); });
+
+  pointer head;
+  read_all(proc.fd, (void*) &head, sizeof(head));
+  join_sender(proc);
+
+  // Nothing resolves until the slabs are reopened
+  assert(slab_lookup_table[head.m_id][head.s_id] == nullptr);
+
+  // The slabs come back under the ids they had, so they can't be reopened
+  // while another allocator has their range of slab ids
+  {
+    SlabAllocator<long> first;
+    *first.allocate(1) = 1;
+
+    bool threw = false;
+    try {
+      allocator_type slab_alloc(dir);
+    } catch (const std::runtime_error&) {
+      threw = true;
+    }
+    assert(threw && "Reopened the slabs under slab ids that are taken");
+  }
+
+  {
+    allocator_type slab_alloc(dir);
+
+    Slab* slab = slab_alloc.internal->slabs[log2_int_ceil(sizeof(Node))];
+    assert(slab != nullptr && "Slab should have been reopened");
+    assert(slab->nth_block(0)->block_md()->start == slab);
+
+    std::cout << "Reopened list at " << head << std::endl;
+    check_list(head, list_sz);
+
+    // The reopened slabs can be allocated from as usual
+    pointer p = slab_alloc.allocate(1);
+    new (&*p) Node(-1);
+    p->next = head;
+    check_list(p->next, list_sz);
+  }
+
+  for (int exp = 0; exp < SlabAllocatorInternal::MAX_SLABS; ++exp) {
+    unlink((dir + "/slab_" + std::to_string(exp)).c_str());
+  }
+  unlink((dir + "/slab_ids").c_str());
+  rmdir(dir.c_str());
+}
@@ -0,0 +1,116 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+// ==============================================================
+// = Test Pinned 1: Build a linked list with fancy pointers     =
+// = whose machine and slab ids are fixed at compile time, and  =
+// = check that they point where full fancy pointers do         =
+// ==============================================================
+
+template <typename T>
+using node_pointer = pinned_fancy_pointer<T, LOCAL_M_ID, SIZE_CLASS_S_ID>;
+
+struct Node {
+  Test value;
+  node_pointer<Node> next;
+
+  Node(int id) : value(id), next(nullptr) {}
+};
+
+using allocator_type = SlabAllocator<Node, node_pointer>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+static_assert(std::is_same_v<pointer, node_pointer<Node>>);
+static_assert(sizeof(pointer) == 8);
+
+// Rebinding keeps the pinned ids, and picks the slab of the new type
+using void_pointer = std::pointer_traits<pointer>::rebind<void>;
+using int_pointer = std::allocator_traits<allocator_type>::rebind_traits<int>::pointer;
+static_assert(std::is_same_v<void_pointer, node_pointer<void>>);
+static_assert(std::is_same_v<int_pointer, node_pointer<int>>);
+
+// Enough nodes for the slab to be resized several times
+int const list_sz = 5000;
+
+int main(void)
+{
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  pointer head = nullptr;
+
+  for (int i = list_sz - 1; i >= 0; --i) {
+    pointer p = slab_alloc.allocate(1);
+    new (&*p) Node(i);
+    p->next = head;
+    head = p;
+
+    fancy_pointer<Node> full = fancy_pointer<Node>::pointer_to(*p);
+    assert(p.m_id() == full.m_id && p.s_id() == full.s_id && p.offset == full.offset);
+  }
+
+  int i = 0;
+  for (pointer p = head; p != nullptr; p = p->next, ++i) {
+    assert(p->value == Test(i) && "Value at ith entry was incorrect");
+    assert(pointer::pointer_to(*p) == p);
+  }
+  assert(i == list_sz && "List has the wrong length");
+
+  // Going through void keeps the slab id
+  void_pointer vp = head;
+  pointer back = static_cast<pointer>(vp);
+  assert(back == head && vp.s_id() == head.s_id());
+
+  // Objects outside of the pinned slab have no pinned pointer
+  Node local(-1);
+  bool threw = false;
+  try {
+    pointer::pointer_to(local);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw && "Pinned pointer to an object outside of its slab");
+
+  // The slot of an array that has no pinned pointer is given back, so it
+  // is the next one to be allocated
+  size_t array_exp = log2_int_ceil(2*sizeof(Node));
+  void *slot = slab_alloc.internal->allocate_slot(array_exp);
+  slab_alloc.internal->deallocate_slot(array_exp, slot);
+
+  threw = false;
+  try {
+    pointer arr = slab_alloc.allocate(2);
+    slab_alloc.deallocate(arr, 2);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw && "Pinned pointer to an array outside of the size class slab");
+  assert(slab_alloc.internal->allocate_slot(array_exp) == slot && "Array slot was leaked");
+  slab_alloc.internal->deallocate_slot(array_exp, slot);
+
+  // Only the first allocator of the process has the size class slab ids,
+  // so a second one fails right away instead of on every allocate
+  threw = false;
+  try {
+    allocator_type second_alloc;
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw && "Pinned allocator without the size class slab ids");
+
+  // With dynamic ids, it is a fancy pointer with a different null
+  using dynamic_pointer = pinned_fancy_pointer<Node>;
+  dynamic_pointer d = dynamic_pointer::pointer_to(*head->next);
+  assert(&*d == &*head->next && d.s_id() == head.s_id());
+  assert(dynamic_pointer() == nullptr && !dynamic_pointer());
+
+  for (pointer p = head; p != nullptr; ) {
+    pointer next = p->next;
+    p->~Node();
+    slab_alloc.deallocate(p, 1);
+    p = next;
+  }
+}
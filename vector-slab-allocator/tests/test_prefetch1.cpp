@@ -0,0 +1,104 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <forward_list>
+#include <iostream>
+#include <list>
+#include <map>
+#include <vector>
+
+// ==============================================================
+// = Test Prefetch 1: Traverse node based containers and linked =
+// = lists on slab memory while prefetching the nodes ahead     =
+// ==============================================================
+
+int const num_nodes = 1000;
+
+struct Node {
+  long value;
+  fancy_pointer<Node> next;
+};
+
+int main(void)
+{
+  long expected = long(num_nodes) * (num_nodes - 1) / 2;
+
+  std::list<long, SlabAllocator<long>> lst;
+  std::forward_list<long, SlabAllocator<long>> flst;
+  std::map<long, long, std::less<long>, SlabAllocator<std::pair<const long, long>>> map;
+  for (long i = 0; i < num_nodes; ++i) {
+    lst.push_back(i);
+    flst.push_front(i);
+    map[i] = i;
+  }
+
+  // Every distance visits every element once, in order, including distances
+  // past the end of the container
+  for (int distance : {0, 1, 4, num_nodes + 1}) {
+    long sum = 0;
+    long prev = -1;
+    for (auto& v : prefetched(lst, distance)) {
+      assert(v == prev + 1 && "Elements of the list out of order");
+      prev = v;
+      sum += v;
+    }
+    assert(sum == expected);
+
+    sum = 0;
+    for (auto& v : prefetched(flst, distance)) {
+      sum += v;
+    }
+    assert(sum == expected);
+
+    sum = 0;
+    prev = -1;
+    for (auto& kv : prefetched(map, distance)) {
+      assert(kv.first == prev + 1 && "Elements of the map out of order");
+      prev = kv.first;
+      sum += kv.second;
+    }
+    assert(sum == expected);
+  }
+
+  // Elements can be modified through the iterator
+  for (auto& v : prefetched(lst)) {
+    ++v;
+  }
+  assert(lst.front() == 1 && lst.back() == num_nodes);
+
+  // Nothing to traverse
+  std::list<long, SlabAllocator<long>> empty;
+  for (auto& v : prefetched(empty)) {
+    (void) v;
+    assert(false && "Traversed an empty list");
+  }
+
+  // A linked list of fancy pointers, ending in a null one
+  SlabAllocator<Node> node_alloc;
+  fancy_pointer<Node> head = nullptr;
+  for (long i = 0; i < num_nodes; ++i) {
+    fancy_pointer<Node> n = node_alloc.allocate(1);
+    n->value = i;
+    n->next = head;
+    head = n;
+  }
+
+  long sum = 0;
+  long prev = num_nodes;
+  for_each_node(head, &Node::next, [&](Node& n) {
+    assert(n.value == prev - 1 && "Nodes visited out of order");
+    prev = n.value;
+    sum += n.value;
+  });
+  assert(sum == expected);
+
+  // Prefetching null, raw and slab pointers is harmless
+  Node local{-1, nullptr};
+  prefetch_pointer(fancy_pointer<Node>(nullptr));
+  prefetch_pointer(fancy_pointer<Node>::pointer_to(local));
+  prefetch_pointer(head);
+  prefetch_pointer(&local);
+
+  for_each_node(fancy_pointer<Node>(nullptr), &Node::next, [](Node&) {
+    assert(false && "Traversed an empty linked list");
+  });
+}
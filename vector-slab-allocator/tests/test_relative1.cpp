@@ -0,0 +1,104 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// ==============================================================
+// = Test Relative 1: Build a linked list whose links are       =
+// = relative pointers within a slab, grow the slab so that it  =
+// = moves, and traverse the list on another machine            =
+// ==============================================================
+
+struct Node {
+  Test value;
+  relative_pointer<Node> next;
+
+  Node(int id) : value(id), next(nullptr) {}
+};
+
+using allocator_type = SlabAllocator<Node, relative_pointer>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+static_assert(std::is_same_v<pointer, relative_pointer<Node>>);
+
+// Enough nodes for the slab to be resized several times
+int const list_sz = 5000;
+
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  fancy_pointer<Node> head = nullptr;
+
+  for (int i = list_sz - 1; i >= 0; --i) {
+    pointer p = slab_alloc.allocate(1);
+    new (&*p) Node(i);
+    if (head != nullptr) {
+      p->next = pointer::pointer_to(*head);
+    }
+    head = fancy_pointer<Node>::pointer_to(*p);
+  }
+
+  // Links survived the moves of the slab
+  int i = 0;
+  for (Node *n = &*head; n != nullptr; n = &*n->next, ++i) {
+    assert(n->value == Test(i) && "Value at ith entry was incorrect");
+  }
+  assert(i == list_sz && "List has the wrong length");
+
+  // Copies point to the same object wherever they are
+  pointer copy = head->next;
+  assert(copy == head->next && &*copy == &*head->next);
+  pointer null_copy = pointer();
+  assert(null_copy == nullptr && !null_copy);
+
+  SlabImage image = slab_alloc.internal->export_slabs();
+
+  ssize_t n = write(fd, &head, sizeof(head));
+  assert(n == sizeof(head));
+  n = writev(fd, image.iov.data(), image.iov.size());
+  assert(n == ssize_t(image.size()) && "writev did not write the whole image");
+}
+
+int main(void)
+{
+  int fds[2];
+  int rc = pipe(fds);
+  assert(rc == 0);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    sender(fds[1]);
+    close(fds[1]);
+    _exit(0);
+  }
+  close(fds[1]);
+
+  std::vector<char> buf;
+  char chunk[4096];
+  ssize_t n;
+  while ((n = read(fds[0], chunk, sizeof(chunk))) > 0) {
+    buf.insert(buf.end(), chunk, chunk + n);
+  }
+  close(fds[0]);
+
+  int status;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "Sender failed");
+
+  // The head is a fancy pointer, but the links are followed without the
+  // slab lookup table
+  fancy_pointer<Node> head;
+  memcpy((void*) &head, buf.data(), sizeof(head));
+  AdoptedSlabImage image(buf.data() + sizeof(head), buf.size() - sizeof(head));
+
+  int i = 0;
+  for (pointer p = pointer::pointer_to(*head); p != nullptr; p = p->next, ++i) {
+    assert(p->value == Test(i) && "Value at ith entry was incorrect");
+  }
+  assert(i == list_sz && "List has the wrong length");
+}
@@ -0,0 +1,105 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// ==============================================================
+// = Test Relocate 1: Build a linked list that ends in a        =
+// = sentinel node on the stack, like the sentinel in the       =
+// = header of a container. The raw pointer to it is found, the =
+// = sentinel is moved into a slab, and the list is sent.       =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int const list_sz = 1000;
+
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  Node sentinel(-1);
+  pointer head = pointer::pointer_to(sentinel);
+  assert(head.s_id == 0 && "The sentinel is not in a slab");
+
+  for (int i = list_sz - 1; i >= 0; --i) {
+    pointer p = slab_alloc.allocate(1);
+    new (&*p) Node(i);
+    p->next = head;
+    head = p;
+  }
+
+  std::vector<SlabPointerLayout> layouts = {pointer_layout<Node>({offsetof(Node, next)})};
+  std::vector<RawPointerRef> refs = slab_alloc.internal->find_raw_pointers(layouts);
+  assert(refs.size() == 1 && "Only the last node points at the sentinel");
+  assert(refs[0].address == uint64_t(&sentinel));
+
+  bool threw = false;
+  try {
+    slab_alloc.internal->export_checked(layouts);
+  } catch (const std::runtime_error& e) {
+    std::cout << "Export refused: " << e.what() << std::endl;
+    threw = true;
+  }
+  assert(threw && "Exporting raw pointers should fail");
+
+  // Moving a Node copies it, so the pointer to it has to be rewritten
+  pointer moved = slab_alloc.internal->relocate_into_slab(&sentinel, layouts);
+  assert(moved.s_id != 0 && moved->value == Test(-1));
+  assert(slab_alloc.internal->find_raw_pointers(layouts).empty());
+
+  SlabImage image = slab_alloc.internal->export_checked(layouts);
+
+  ssize_t n = write(fd, &head, sizeof(head));
+  assert(n == sizeof(head));
+  n = writev(fd, image.iov.data(), image.iov.size());
+  assert(n == ssize_t(image.size()) && "writev did not write the whole image");
+}
+
+int main(void)
+{
+  int fds[2];
+  int rc = pipe(fds);
+  assert(rc == 0);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    sender(fds[1]);
+    close(fds[1]);
+    _exit(0);
+  }
+  close(fds[1]);
+
+  std::vector<char> buf;
+  char chunk[4096];
+  ssize_t n;
+  while ((n = read(fds[0], chunk, sizeof(chunk))) > 0) {
+    buf.insert(buf.end(), chunk, chunk + n);
+  }
+  close(fds[0]);
+
+  int status;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "Sender failed");
+
+  pointer head;
+  memcpy((void*) &head, buf.data(), sizeof(head));
+  AdoptedSlabImage image(buf.data() + sizeof(head), buf.size() - sizeof(head));
+
+  // The list now ends in the sentinel, which arrived in the slabs
+  int i = 0;
+  pointer p = head;
+  for (; p->value.id != -1; p = p->next, ++i) {
+    assert(p->value == Test(i) && "Value at ith entry was incorrect");
+  }
+  assert(i == list_sz && "List has the wrong length");
+  assert(p.m_id == 1 && p.s_id != 0 && "Sentinel should be in a slab");
+}
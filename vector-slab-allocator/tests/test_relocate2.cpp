@@ -0,0 +1,74 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <iostream>
+#include <list>
+#include <memory>
+#include <vector>
+
+// ==============================================================
+// = Test Relocate 2: Build a std::list whose header is on the  =
+// = stack, so its first and last nodes point at the sentinel   =
+// = in the header. Relocating the list into a slab moves the   =
+// = header, and the list is sent and traversed on the receiver =
+// ==============================================================
+
+using list_type = std::list<long, SlabAllocator<long>>;
+
+int const list_sz = 1000;
+
+// The nodes of a list are (prev, next, value), where prev and next are
+// fancy pointers (see std::__list_node in libc++)
+SlabPointerLayout list_node_layout() {
+  size_t ptr_sz = sizeof(fancy_pointer<void>);
+  return SlabPointerLayout{round_pow2(2*ptr_sz + sizeof(long)), {0, ptr_sz}};
+}
+
+void sender(int fd) {
+  set_machine_id(1);
+
+  SlabAllocator<long> slab_alloc;
+  std::vector<SlabPointerLayout> layouts = {list_node_layout()};
+
+  list_type lst(slab_alloc);
+  for (int i = 0; i < list_sz; ++i) {
+    lst.push_back(i);
+  }
+
+  std::vector<RawPointerRef> refs = slab_alloc.internal->find_raw_pointers(layouts);
+  assert(refs.size() == 2 && "The first and last nodes point at the sentinel");
+
+  fancy_pointer<list_type> moved = slab_alloc.internal->relocate_into_slab(&lst, layouts);
+  assert(lst.empty() && "The list should have been moved from");
+  assert(moved->size() == list_sz);
+  assert(slab_alloc.internal->find_raw_pointers(layouts).empty() &&
+         "Moving the list should point its nodes at the new sentinel");
+
+  SlabImage image = slab_alloc.internal->export_checked(layouts);
+  write_all(fd, &moved, sizeof(moved));
+  write_image(fd, image);
+
+  // The relocated list is destroyed like any other object in the slabs
+  moved->~list_type();
+  SlabAllocator<list_type>(slab_alloc).deallocate(moved, 1);
+}
+
+int main(void)
+{
+  SenderProcess proc = fork_sender(sender);
+
+  fancy_pointer<list_type> lst;
+  read_all(proc.fd, (void*) &lst, sizeof(lst));
+  std::vector<char> buf = read_image(proc.fd);
+  join_sender(proc);
+
+  AdoptedSlabImage image(buf.data(), buf.size());
+
+  // Only traverse the list: its allocator is only valid on the sender
+  long i = 0;
+  for (long value : *lst) {
+    assert(value == i && "Value at ith entry was incorrect");
+    ++i;
+  }
+  assert(i == list_sz && "List has the wrong length");
+  std::cout << "Traversed " << i << " elements of the relocated list" << std::endl;
+}
@@ -0,0 +1,80 @@
+#include "slab.h"
+#include "test_defs.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+// ==============================================================
+// = Test Reserve 1: A slab on the heap grows in place inside   =
+// = the address space it reserved, so raw pointers into it     =
+// = stay valid and nothing is copied, and a slab that can't be =
+// = registered gives its reservation back                      =
+// ==============================================================
+
+int const num_values = 200000;
+
+// Bytes of address space that this process has mapped
+size_t mapped_bytes() {
+  std::ifstream statm("/proc/self/statm");
+  size_t pages;
+  statm >> pages;
+  return pages * sysconf(_SC_PAGESIZE);
+}
+
+int main(void)
+{
+  Slab slab(sizeof(long));
+  assert(slab.reserved && slab.capacity == SLAB_RESERVE_SZ);
+
+  char *blocks = slab.blocks;
+  uint32_t generation = slab_lookup_table[slab.m_id].generation(slab.s_id);
+  std::vector<long*> entries;
+  int resizes = 0;
+
+  for (int i = 0; i < num_values; ++i) {
+    auto [ret, did_resize, new_blocks] = slab.allocate();
+    if (did_resize) {
+      ++resizes;
+      assert(new_blocks == blocks && "Blocks moved while growing");
+    }
+
+    entries.push_back((long*) ret);
+    *entries.back() = i;
+  }
+  std::cout << "Resizes: " << resizes << ", size: " << slab.size() << std::endl;
+
+  assert(resizes > 0);
+  assert(slab.size() <= slab.capacity);
+  assert(slab_lookup_table[slab.m_id].generation(slab.s_id) == generation &&
+         "Growing in place should not invalidate cached blocks");
+
+  // Pointers taken before the slab grew still point at their values, and
+  // the slab index knows about the blocks that were added
+  for (int i = 0; i < num_values; ++i) {
+    assert(*entries[i] == i && "Value at ith entry was incorrect");
+  }
+  assert(slab_index_lookup(entries.back()) == slab_index_code(slab.m_id, slab.s_id));
+
+  // Only the blocks are indexed, not the rest of the reservation
+  assert(slab_index_lookup(slab.blocks + slab.capacity - 1) == 0);
+
+  for (long *p : entries) {
+    slab.deallocate(p);
+  }
+
+  // A slab whose slab ID is in use throws, without keeping its reservation
+  // or the entry of the slab that already has the ID
+  size_t before = mapped_bytes();
+  for (int i = 0; i < 16; ++i) {
+    bool threw = false;
+    try {
+      Slab taken(sizeof(long), SlabId{slab.s_id});
+    } catch (std::runtime_error&) {
+      threw = true;
+    }
+    assert(threw && "Slab ID in use should be refused");
+  }
+  assert(mapped_bytes() < before + SLAB_RESERVE_SZ && "Reservation leaked");
+  assert(slab_lookup_table[slab.m_id][slab.s_id] == reinterpret_cast<char*>(&slab));
+}
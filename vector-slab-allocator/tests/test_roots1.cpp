@@ -0,0 +1,72 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// ==============================================================
+// = Test Roots 1: Send an image with two linked lists and a    =
+// = single node in it, registered as roots. The receiver finds =
+// = them by name and by id after adopting the image, without   =
+// = being told where they are. A second allocator on the same  =
+// = machine has roots of its own, which are found as well.     =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int const list_sz = 500;
+uint64_t const single_id = 42;
+
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  slab_alloc.internal->set_root("evens", make_list(slab_alloc, list_sz, 0, 2));
+  slab_alloc.internal->set_root("odds", make_list(slab_alloc, list_sz, 1, 2));
+
+  pointer single = slab_alloc.allocate(1);
+  new (&*single) Node(-1);
+  slab_alloc.internal->set_root(single_id, single);
+
+  // Roots are found on the sender too
+  assert(find_slab_root<Node>(1, "odds")->value == Test(1));
+
+  // Another allocator keeps its roots in a table of its own
+  allocator_type other_alloc;
+  assert(other_alloc.internal->id_base != slab_alloc.internal->id_base);
+  other_alloc.internal->set_root("other", make_list(other_alloc, list_sz, 7));
+  check_list(find_slab_root<Node>(1, "other"), list_sz, 7);
+  assert(find_slab_root<Node>(1, "odds")->value == Test(1));
+
+  SlabImage image = slab_alloc.internal->export_slabs();
+  write_image(fd, image);
+  SlabImage other_image = other_alloc.internal->export_slabs();
+  write_image(fd, other_image);
+}
+
+int main(void)
+{
+  SenderProcess proc = fork_sender(sender);
+  std::vector<char> buf = read_image(proc.fd);
+  std::vector<char> other_buf = read_image(proc.fd);
+
+  AdoptedSlabImage adopted(buf.data(), buf.size());
+  AdoptedSlabImage other_adopted(other_buf.data(), other_buf.size());
+
+  check_list(find_slab_root<Node>(adopted.m_id, "evens"), list_sz, 0, 2);
+  check_list(find_slab_root<Node>(adopted.m_id, "odds"), list_sz, 1, 2);
+
+  pointer single = find_slab_root<Node>(adopted.m_id, single_id);
+  assert(single != nullptr && single->value == Test(-1));
+
+  check_list(find_slab_root<Node>(adopted.m_id, "other"), list_sz, 7);
+
+  assert(find_slab_root<Node>(adopted.m_id, "missing") == nullptr);
+  assert(find_slab_root<Node>(adopted.m_id, 7) == nullptr);
+
+  std::cout << "Found every root in the adopted image" << std::endl;
+
+  join_sender(proc);
+}
@@ -0,0 +1,80 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <iostream>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// ==============================================================
+// = Test Segment 1: Several processes build linked lists in    =
+// = one slab segment at the same time, freeing some of their   =
+// = nodes as they go. Another process attaches to the segment  =
+// = afterwards and traverses every list.                       =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int const num_writers = 4;
+int const list_sz = 1000;
+int const segment_m_id = 10;
+
+void writer(int k, int seg_fd, int fd) {
+  set_machine_id(1 + k);
+
+  allocator_type slab_alloc(shared_segment, dup(seg_fd));
+  pointer head = nullptr;
+
+  for (int i = list_sz - 1; i >= 0; --i) {
+    // Leave holes behind for the other writers to fill
+    pointer temp = slab_alloc.allocate(1);
+
+    pointer p = slab_alloc.allocate(1);
+    new (&*p) Node(k * list_sz + i);
+    p->next = head;
+    head = p;
+
+    slab_alloc.deallocate(temp, 1);
+  }
+
+  assert(head.m_id == segment_m_id && "Node should be in the segment");
+
+  write_all(fd, &head, sizeof(head));
+}
+
+int main(void)
+{
+  int seg_fd = memfd_create("slab_segment", 0);
+  assert(seg_fd >= 0);
+
+  {
+    // Create the segment, but leave the allocating to the writers
+    allocator_type creator(shared_segment, dup(seg_fd), segment_m_id);
+  }
+
+  std::vector<SenderProcess> writers;
+  for (int k = 0; k < num_writers; ++k) {
+    writers.push_back(fork_sender([k, seg_fd](int fd) { writer(k, seg_fd, fd); }));
+  }
+
+  std::vector<pointer> heads(num_writers);
+  for (int k = 0; k < num_writers; ++k) {
+    read_all(writers[k].fd, (void*) &heads[k], sizeof(pointer));
+    join_sender(writers[k]);
+  }
+
+  allocator_type slab_alloc(shared_segment, dup(seg_fd));
+
+  for (int k = 0; k < num_writers; ++k) {
+    check_list(heads[k], list_sz, k * list_sz);
+  }
+
+  // This process can allocate from the segment too
+  pointer p = slab_alloc.allocate(1);
+  assert(p.m_id == segment_m_id);
+  slab_alloc.deallocate(p, 1);
+
+  std::cout << "Traversed " << num_writers << " lists built in the segment" << std::endl;
+  close(seg_fd);
+}
@@ -0,0 +1,107 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+// ==============================================================
+// = Test Share 1: Build a linked list in memfd backed slabs,   =
+// = send the file descriptors of the slabs to another process, =
+// = and traverse the list there through read-only mappings,    =
+// = which stay mapped while a reader may still use them        =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int const list_sz = 1000;
+
+void sender(int sock) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc(memfd_backed);
+  pointer head = make_list(slab_alloc, list_sz);
+
+  ssize_t n = write(sock, &head, sizeof(head));
+  assert(n == sizeof(head));
+  slab_alloc.internal->share_slabs(sock);
+
+  // Wait until the other process traversed the list
+  char c;
+  n = read(sock, &c, 1);
+  assert(n == 1);
+
+  // Writes after sharing are visible to the other process
+  head->value.id = -1;
+  c = 'w';
+  n = write(sock, &c, 1);
+  assert(n == 1);
+
+  // Keep the slabs alive until the other process is done
+  n = read(sock, &c, 1);
+  assert(n == 1);
+}
+
+int main(void)
+{
+  int socks[2];
+  int rc = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, socks);
+  assert(rc == 0);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(socks[0]);
+    sender(socks[1]);
+    close(socks[1]);
+    _exit(0);
+  }
+  close(socks[1]);
+  int sock = socks[0];
+
+  pointer head;
+  ssize_t n = read(sock, (void*) &head, sizeof(head));
+  assert(n == sizeof(head));
+
+  std::unique_ptr<SharedSlabs> shared(new SharedSlabs(sock));
+  assert(shared->m_id == 1);
+
+  check_list(head, list_sz);
+
+  char c = 't';
+  n = write(sock, &c, 1);
+  assert(n == 1);
+  n = read(sock, &c, 1);
+  assert(n == 1);
+  std::cout << "Head after the sender wrote to it: " << head->value << std::endl;
+  assert(head->value.id == -1 && "Write by the sender should be visible");
+
+  // A reader inside a SlabReadGuard can still use the blocks after the
+  // slabs are dropped, until it leaves the guard
+  std::atomic<int> step{0};
+  std::thread reader([&]() {
+    SlabReadGuard guard;
+    Node *raw = &*head;
+    step = 1;
+    while (step.load() != 2) {}
+    assert(raw->value.id == -1 && "Blocks unmapped while a reader could use them");
+  });
+  while (step.load() != 1) {}
+  shared.reset();
+  assert(slab_lookup_table[1][head.s_id] == nullptr);
+  step = 2;
+  reader.join();
+  synchronize_slab_readers();
+
+  n = write(sock, &c, 1);
+  assert(n == 1);
+  close(sock);
+
+  int status;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0 && "Sender failed");
+}
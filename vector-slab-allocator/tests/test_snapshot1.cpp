@@ -0,0 +1,84 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// ==============================================================
+// = Test Snapshot 1: Take a snapshot of a linked list, and     =
+// = overwrite every node and keep allocating before the image  =
+// = is read. The receiver gets the list as it was at the       =
+// = snapshot, while the sender sees its own writes.            =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int const list_sz = 2000;
+
+// Snapshot a list and write its image to [fd], but only tell the receiver
+// to read it through [sig_fd] once the list has been overwritten
+void sender(int fd, int sig_fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  pointer head = make_list(slab_alloc, list_sz);
+  write_all(fd, &head, sizeof(head));
+
+  // The image is the rest of what is written to [fd]
+  SlabSnapshot snap = slab_alloc.internal->snapshot(fd);
+
+  for (pointer p = head; p != nullptr; p = p->next) {
+    p->value.id = -1;
+  }
+  pointer other = make_list(slab_alloc, list_sz, list_sz);
+  check_list(other, list_sz, list_sz);
+
+  // The image is larger than the pipe, and nothing was read yet, so the
+  // snapshot is still being written
+  assert(!snap.done() && "Snapshot was written before the list changed");
+  for (pointer p = head; p != nullptr; p = p->next) {
+    assert(p->value.id == -1 && "Sender should see its own writes");
+  }
+
+  char c = 'w';
+  write_all(sig_fd, &c, 1);
+  snap.wait();
+}
+
+int main(void)
+{
+  int sig[2];
+  int rc = pipe(sig);
+  assert(rc == 0);
+
+  SenderProcess proc = fork_sender([&sig](int fd) {
+    close(sig[0]);
+    sender(fd, sig[1]);
+  });
+  close(sig[1]);
+
+  pointer head;
+  read_all(proc.fd, (void*) &head, sizeof(head));
+
+  // Wait until the sender has overwritten the list
+  char c;
+  read_all(sig[0], &c, 1);
+  close(sig[0]);
+
+  std::vector<char> buf;
+  char chunk[4096];
+  ssize_t n;
+  while ((n = read(proc.fd, chunk, sizeof(chunk))) > 0) {
+    buf.insert(buf.end(), chunk, chunk + n);
+  }
+  assert(buf.size() > 64 * 1024 && "Image should not fit in the pipe");
+
+  AdoptedSlabImage adopted(buf.data(), buf.size());
+
+  check_list(head, list_sz);
+  std::cout << "Snapshot of " << buf.size() << " bytes was consistent" << std::endl;
+
+  join_sender(proc);
+}
@@ -0,0 +1,80 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// ==============================================================
+// = Test Sparse 1: Send a sparse image of a linked list whose  =
+// = slab has empty blocks in the middle (freed objects) and at =
+// = the end (after a resize). The receiver rebuilds the slab   =
+// = at the right offsets and the list is valid.                =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int const list_sz = 1000;
+int const num_temp = 300;
+
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+
+  // Put temporary nodes between the two halves of the list, then free them
+  pointer tail = make_list(slab_alloc, list_sz / 2 - 1, list_sz / 2 + 1);
+  std::vector<pointer> temp;
+  for (int j = 0; j < num_temp; ++j) {
+    temp.push_back(slab_alloc.allocate(1));
+  }
+  pointer head = make_list(slab_alloc, list_sz / 2 + 1);
+  pointer last = head;
+  while (last->next != nullptr) {
+    last = last->next;
+  }
+  last->next = tail;
+  for (pointer p : temp) {
+    slab_alloc.deallocate(p, 1);
+  }
+
+  SlabImage full = slab_alloc.internal->export_slabs();
+  SlabImage sparse = slab_alloc.internal->export_sparse();
+
+  std::cout << "Full image: " << full.size() << " bytes, sparse: "
+            << sparse.size() << " bytes" << std::endl;
+  assert(sparse.size() < full.size() && "Sparse image should be smaller");
+
+  // One run before the freed blocks, and one after them
+  assert(sparse.image_header()->num_slabs == 1);
+  assert(sparse.entries()[0].num_runs == 2);
+  assert(sparse.entries()[0].num_blocks == full.entries()[0].num_blocks);
+
+  write_all(fd, &head, sizeof(head));
+  write_image(fd, sparse);
+}
+
+int main(void)
+{
+  SenderProcess proc = fork_sender(sender);
+
+  pointer head;
+  read_all(proc.fd, (void*) &head, sizeof(head));
+  std::vector<char> buf = read_image(proc.fd);
+
+  SlabReplica replica;
+  replica.apply(buf.data(), buf.size());
+  check_list(head, list_sz);
+
+  // The blocks that were left out are empty in the replica
+  Slab* slab = replica.slabs[head.s_id].get();
+  int num_empty = 0;
+  for (int n = 0; n < slab->slab_md()->num_blocks; ++n) {
+    num_empty += slab->is_block_empty(n);
+  }
+  std::cout << "Empty blocks in the replica: " << num_empty << std::endl;
+  assert(num_empty > 0);
+
+  join_sender(proc);
+}
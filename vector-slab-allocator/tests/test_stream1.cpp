@@ -0,0 +1,70 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// ==============================================================
+// = Test Stream 1: Append to a linked list while its complete  =
+// = blocks are streamed to another process. The receiver       =
+// = applies every image to a replica as it arrives, and the    =
+// = list is valid after the final flush.                       =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+int const list_sz = 5000;
+
+// The end of the stream of images is followed by the head of the list
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  int num_images = 0;
+  slab_alloc.internal->stream_to([&](SlabImage& image) {
+    write_image(fd, image);
+    ++num_images;
+  });
+
+  // Append to the tail, which writes to the node before each new node
+  pointer head = nullptr;
+  pointer tail = nullptr;
+  for (int i = 0; i < list_sz; ++i) {
+    pointer p = slab_alloc.allocate(1);
+    new (&*p) Node(i);
+    if (tail == nullptr) {
+      head = p;
+    } else {
+      tail->next = p;
+    }
+    tail = p;
+  }
+
+  int streamed = num_images;
+  slab_alloc.internal->flush_stream();
+  std::cout << "Images streamed while building: " << streamed
+            << ", at the flush: " << num_images - streamed << std::endl;
+  assert(streamed > 1 && "Blocks should be sent before the list is complete");
+
+  write_end(fd);
+  write_all(fd, &head, sizeof(head));
+}
+
+int main(void)
+{
+  SenderProcess proc = fork_sender(sender);
+
+  SlabReplica replica;
+  for (std::vector<char> buf = read_image(proc.fd); !buf.empty();
+       buf = read_image(proc.fd)) {
+    replica.apply(buf.data(), buf.size());
+  }
+
+  pointer head;
+  read_all(proc.fd, (void*) &head, sizeof(head));
+  check_list(head, list_sz);
+
+  join_sender(proc);
+}
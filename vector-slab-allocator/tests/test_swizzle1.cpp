@@ -0,0 +1,80 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// ==============================================================
+// = Test Swizzle 1: Adopt a linked list from another machine,  =
+// = swizzle it to raw pointers and traverse it, then unswizzle =
+// = it and check that the image is back to what was received.  =
+// = Data that looks like a fancy pointer is left alone.        =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+// Bytes that hold a copy of a fancy pointer, but are not one
+struct Decoy {
+  char bytes[sizeof(pointer) + 8];
+};
+
+int const list_sz = 1000;
+
+// Writes the head of the list and a decoy, followed by the image
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  pointer head = make_list(slab_alloc, list_sz);
+
+  SlabAllocator<Decoy> decoy_alloc(slab_alloc);
+  fancy_pointer<Decoy> decoy = decoy_alloc.allocate(1);
+  memset(decoy->bytes, 0, sizeof(decoy->bytes));
+  memcpy(decoy->bytes, (void*) &head, sizeof(head));
+
+  SlabImage image = slab_alloc.internal->export_slabs();
+  write_all(fd, &head, sizeof(head));
+  write_all(fd, &decoy, sizeof(decoy));
+  write_image(fd, image);
+}
+
+int main(void)
+{
+  SenderProcess proc = fork_sender(sender);
+
+  pointer head;
+  fancy_pointer<Decoy> decoy;
+  read_all(proc.fd, (void*) &head, sizeof(head));
+  read_all(proc.fd, (void*) &decoy, sizeof(decoy));
+  std::vector<char> buf = read_image(proc.fd);
+  join_sender(proc);
+
+  std::vector<char> received = buf;
+  AdoptedSlabImage image(buf.data(), buf.size());
+  std::vector<SlabPointerLayout> layouts = {pointer_layout<Node>({offsetof(Node, next)})};
+
+  size_t swizzled = swizzle_slabs(image.slabs, layouts);
+  swizzle_pointer(head);
+  std::cout << "Swizzled " << swizzled << " pointers" << std::endl;
+  assert(swizzled == list_sz - 1 && "Every non-null next pointer should be swizzled");
+  assert(head.s_id == 0 && head->next.s_id == 0);
+
+  int i = 0;
+  for (pointer p = head; p != nullptr; p = p->next, ++i) {
+    assert(p->value == Test(i) && "Value at ith entry was incorrect");
+    assert(pointer::pointer_to(*p) == p && "pointer_to should return raw pointers");
+  }
+  assert(i == list_sz && "List has the wrong length");
+
+  // The decoy is in slots that no layout describes
+  pointer copy;
+  memcpy((void*) &copy, decoy->bytes, sizeof(copy));
+  assert(copy.m_id == 1 && copy.s_id != 0 && "Decoy should not be swizzled");
+
+  size_t unswizzled = unswizzle_slabs(image.slabs, layouts);
+  assert(unswizzled == swizzled);
+  assert(buf == received && "Unswizzling should restore the image");
+}
@@ -0,0 +1,85 @@
+#include "slab_allocator.h"
+#include "test_defs.h"
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// ==============================================================
+// = Test Table 1: Many allocators with slabs of the same size  =
+// = each get slab ids of their own, while they are registered  =
+// = in the slab lookup table under a thread that follows       =
+// = pointers                                                   =
+// ==============================================================
+
+int const num_allocators = 1000;
+
+int main(void)
+{
+  std::vector<std::unique_ptr<SlabAllocator<long>>> allocs;
+  std::vector<fancy_pointer<long>> ptrs;
+  ptrs.reserve(num_allocators);
+
+  // The first allocator gets the slab id of its size class
+  allocs.emplace_back(new SlabAllocator<long>());
+  ptrs.push_back(allocs[0]->allocate(1));
+  *ptrs[0] = 0;
+  assert(ptrs[0].s_id == int(log2_int_ceil(sizeof(long))) + 1);
+
+  // Follow the pointers allocated so far while slabs are registered,
+  // including the ones in pages of the row that were not used before
+  std::atomic<bool> done{false};
+  std::atomic<long> published{1};
+  std::atomic<long> reads{0};
+  std::thread reader([&]() {
+    while (!done.load()) {
+      long n = published.load();
+      for (long i = 0; i < n; ++i) {
+        assert(*ptrs[i] == i && "Pointer changed while slabs were registered");
+      }
+      ++reads;
+    }
+  });
+
+  for (long i = 1; i < num_allocators; ++i) {
+    allocs.emplace_back(new SlabAllocator<long>());
+    ptrs.push_back(allocs[i]->allocate(1));
+    *ptrs[i] = i;
+    published.store(i + 1);
+
+    // Let the reader catch up now and then, so that it follows pointers
+    // while entries are written
+    if (i % 100 == 0) {
+      for (long r = reads.load(); reads.load() < r + 2; ) {}
+    }
+  }
+  done = true;
+  reader.join();
+  std::cout << "Reads while registering: " << reads << std::endl;
+
+  // The entries of the row span more than a page
+  assert(slab_lookup_table[M_ID].size() * sizeof(SlabTableEntry) > 4096);
+
+  // Every allocator has a slab of its own, so no pointer was redirected
+  for (long i = 0; i < num_allocators; ++i) {
+    assert(*ptrs[i] == i && "Pointer resolved into another allocator's slab");
+    assert(fancy_pointer<long>::pointer_to(*ptrs[i]) == ptrs[i]);
+    for (long j = 0; j < i; ++j) {
+      assert(ptrs[i].s_id != ptrs[j].s_id && "Slab ids should be distinct");
+    }
+  }
+
+  // The ids of destroyed slabs are free again
+  int freed = ptrs[1].s_id;
+  allocs[1].reset();
+  assert(slab_lookup_table[M_ID][freed] == nullptr);
+  SlabAllocator<long> again;
+  fancy_pointer<long> p = again.allocate(1);
+  assert(p.s_id == freed);
+
+  // Null and out of range pointers resolve to their offset
+  assert(slab_lookup_table[-1][-1] == nullptr);
+  assert(slab_lookup_table[M_ID][MAX_SLAB_IDS] == nullptr);
+  assert(fancy_pointer<long>::to_address(nullptr) == nullptr);
+}
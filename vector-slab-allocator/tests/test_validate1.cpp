@@ -0,0 +1,103 @@
+#include "slab_allocator.h"
+#include "test_image_defs.h"
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// ==============================================================
+// = Test Validate 1: Receive a linked list from another        =
+// = machine and validate it, then corrupt some of its pointers =
+// = and its metadata, and check that validation catches it,    =
+// = but not data that only looks like an invalid pointer       =
+// ==============================================================
+
+using Node = TestNode<fancy_pointer>;
+using allocator_type = SlabAllocator<Node>;
+using pointer = std::allocator_traits<allocator_type>::pointer;
+
+// Bytes that look like an invalid fancy pointer, but are not one
+struct Decoy {
+  int m_id;
+  int s_id;
+  int64_t offset;
+  int64_t more;
+};
+
+int const list_sz = 5000;
+
+void sender(int fd) {
+  set_machine_id(1);
+
+  allocator_type slab_alloc;
+  pointer head = make_list(slab_alloc, list_sz);
+
+  SlabAllocator<Decoy> decoy_alloc(slab_alloc);
+  *decoy_alloc.allocate(1) = Decoy{1, 30, 12345, 0};
+
+  SlabImage image = slab_alloc.internal->export_slabs();
+  write_all(fd, &head, sizeof(head));
+  write_image(fd, image);
+}
+
+int main(void)
+{
+  SenderProcess proc = fork_sender(sender);
+
+  pointer head;
+  read_all(proc.fd, (void*) &head, sizeof(head));
+  std::vector<char> buf = read_image(proc.fd);
+  join_sender(proc);
+
+  char *image_buf = buf.data();
+  size_t image_sz = buf.size();
+  std::vector<SlabPointerLayout> layouts = {pointer_layout<Node>({offsetof(Node, next)})};
+
+  {
+    AdoptedSlabImage image(image_buf, image_sz);
+    assert(count_invalid_pointers(image.slabs, layouts) == 0);
+    validate_slabs(image.slabs, layouts, 4);
+
+    // Point nodes past the end of their slab, into a slab that was not
+    // sent, at a raw address, and into the slabs of this machine and of a
+    // machine other than the sender
+    Slab *slab = reinterpret_cast<Slab*>(slab_lookup_table[head.m_id][head.s_id]);
+    std::vector<pointer> nodes;
+    for (pointer p = head; nodes.size() < 5; p = p->next) {
+      nodes.push_back(p);
+    }
+    nodes[0]->next.offset = slab->size() + 64;
+    nodes[1]->next.s_id = 30;
+    nodes[2]->next = pointer(0, 0, uint64_t(&head));
+    nodes[3]->next.m_id = M_ID;
+    nodes[4]->next.m_id = 7;
+    size_t bad = count_invalid_pointers(image.slabs, layouts, 4);
+    std::cout << "Invalid pointers after corrupting five: " << bad << std::endl;
+    assert(bad == 5);
+
+    bool threw = false;
+    try {
+      validate_slabs(image.slabs, layouts, 4);
+    } catch (const std::runtime_error&) {
+      threw = true;
+    }
+    assert(threw && "Validation should fail");
+
+    // Without a layout for them, the nodes are not checked
+    assert(count_invalid_pointers(image.slabs, {}) == 0);
+  }
+
+  // Claim more blocks in the slab metadata than the image holds
+  SlabImageView view(image_buf, image_sz);
+  SlabMD *md = reinterpret_cast<Block*>(image_buf + view.run_offsets[0])->slab_md();
+  md->num_blocks *= 2;
+
+  bool threw = false;
+  try {
+    AdoptedSlabImage image(image_buf, image_sz);
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  assert(threw && "Adopting should fail");
+}